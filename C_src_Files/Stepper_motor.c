@@ -7,261 +7,512 @@
 
 // Target Platform: EK-TM4C123GXL
 // Target uC:       TM4C123GH6PM
-// System Clock:    -
+// System Clock:    40 MHz
 
 // Hardware configuration:
-//Stepper Motor interface through PORT E
+//Each motor is described by a STEPPER_PINS descriptor (four coil pins on one GPIO port)
+//Carousel motor interface through PORT E (PE2 green, PE3 yellow, PE4 black, PE5 white)
 //-----------------------------------------------------------------------------
 // Device includes, defines, and assembler directives
 //-----------------------------------------------------------------------------
 
 #include <stdint.h>
-#include <stdio.h>
 #include <stdbool.h>
-#include <string.h>
-#include "clock.h"
 #include "tm4c123gh6pm.h"
+#include "clock.h"
 #include "wait.h"
-#include "uart0.h"
+#include "eeprom.h"
+#include "udma.h"
+#include "cancel.h"
+#include "tick.h"
 #include "Stepper_motor.h"
 
-// Port E Bitband aliases
-#define PE2_GREEN       (*((volatile uint32_t *)(0x42000000 + (0x400243FC-0x40000000)*32 + 2*4)))
-#define PE3_YELLOW      (*((volatile uint32_t *)(0x42000000 + (0x400243FC-0x40000000)*32 + 3*4)))
-#define PE4_BLACK       (*((volatile uint32_t *)(0x42000000 + (0x400243FC-0x40000000)*32 + 4*4)))
-#define PE5_WHITE       (*((volatile uint32_t *)(0x42000000 + (0x400243FC-0x40000000)*32 + 5*4)))
-
 // PortE masks
 #define PE2_GREEN_MASK              4
 #define PE3_YELLOW_MASK             8
 #define PE4_BLACK_MASK              16
 #define PE5_WHITE_MASK              32
 
+// GPIO register offsets from the port base address
+#define GPIO_DIR_OFFSET             0x400
+#define GPIO_DR2R_OFFSET            0x500
+#define GPIO_DEN_OFFSET             0x51C
+#define GPIO_REG(base, offset)      (*((volatile uint32_t *)((base) + (offset))))
+
+// uDMA step generation, one phase word is written per timer slot
+// The slot of a move divides every step period exactly, moves needing a shorter slot are stepped by the CPU
+#define DMA_MIN_SLOT_US             100
+#define DMA_SLOTS                   2048    // ping-pong halves of 1024 transfers
+
+// Stored state word: magic(31:24) phase(23:16) position(15:8) check(7:0)
+#define STATE_MAGIC                 0xC5
+// Stored profile words: magic(31:24) ramp steps(23:16) step period(15:0), then start period
+#define PROFILE_MAGIC               0xA7
+
 //-----------------------------------------------------------------------------
 // Global variables
 //-----------------------------------------------------------------------------
-uint8_t phase               = 0     ;
-uint8_t position            = 0     ;
-uint8_t i                   = 0     ;
-uint8_t Req_tube_pos        = 0     ;
-uint8_t Present_tube_pos    = 0     ;
-int8_t  Tube_distance       = 0     ;
-char     code_str[20]       ={0}    ;
+
+//step position of each carousel tube, 0 is the reference tube
+const uint8_t carousel_tubes[6]     = {195, 28, 62, 96, 129, 162}   ;
+
+//carousel coils on Port E, phase order black, yellow, white, green
+const STEPPER_PINS carousel_pins    =
+{
+    0x40024000, SYSCTL_RCGCGPIO_R4,
+    {PE4_BLACK_MASK, PE3_YELLOW_MASK, PE5_WHITE_MASK, PE2_GREEN_MASK}
+};
+
+STEPPER carousel =
+{
+    &carousel_pins,
+    {10000, 20000, 5},                  //10 ms cruise, ramp from 20 ms over 5 steps
+    carousel_tubes, 6,
+    200, 5,                             //drive 200 steps into the stop, back off 5
+    EEPROM_STEPPER_STATE
+};
+
+//uDMA step generation serves one motor at a time
+STEPPER *dma_owner                  = 0     ;
+uint8_t  step_table[DMA_SLOTS]              ;
+
 //-----------------------------------------------------------------------------
 // Subroutines
 //-----------------------------------------------------------------------------
 
-//This function initialize the stepper motor and set the home position
+//initStepper() configures the coil pins and restores the last position, homing only if the stored state is not valid
+void initStepper(STEPPER *motor)
+{
+    uint8_t mask = motor->pins->phaseMask[0] | motor->pins->phaseMask[1] | motor->pins->phaseMask[2] | motor->pins->phaseMask[3] ;
+
+    //Enable Clock for the port
+    SYSCTL_RCGCGPIO_R |= motor->pins->rcgcMask  ;
+    _delay_cycles(3);
+
+    GPIO_REG(motor->pins->portBase, GPIO_DIR_OFFSET)    |= mask ;   //configured as outputs
+    GPIO_REG(motor->pins->portBase, GPIO_DR2R_OFFSET)   |= mask ;   //setting output current to 2mA
+    GPIO_REG(motor->pins->portBase, GPIO_DEN_OFFSET)    |= mask ;   //data enable
+
+    if(motor->eepromAddress != STEPPER_NO_EEPROM)
+        restoreStepperProfile(motor)    ;
+    if(!(motor->eepromAddress != STEPPER_NO_EEPROM && restoreStepperState(motor)))
+        homeStepper(motor)  ;
+}
+
+//initStepperMotor() initializes the carousel motor, a failed EEPROM leaves it unpersisted and forces homing
 void initStepperMotor()
 {
-    //Enable Clock for PORT E
-    SYSCTL_RCGCGPIO_R |= SYSCTL_RCGCGPIO_R4     ;
+    if(!initEeprom())
+        carousel.eepromAddress = STEPPER_NO_EEPROM  ;
+    initStepper(&carousel)      ;
+}
+
+//saveStepperState() records position and phase, the EEPROM is only written if the stored word differs
+void saveStepperState(STEPPER *motor)
+{
+    uint8_t  check = ~(STATE_MAGIC + motor->phase + motor->position) ;
+    uint32_t state = ((uint32_t)STATE_MAGIC << 24) | ((uint32_t)motor->phase << 16) | ((uint32_t)motor->position << 8) | check ;
+    if(motor->eepromAddress == STEPPER_NO_EEPROM)
+        return  ;
+    if(readEeprom(motor->eepromAddress) != state)
+        writeEeprom(motor->eepromAddress, state)    ;
+    motor->stateSaved = true    ;
+    motor->stateDirty = false   ;
+}
+
+//flushStepperState() stores the final state once the motor has been idle for STEPPER_SAVE_IDLE_MS
+//A session of moves costs two EEPROM writes, the invalidation before its first move and this one
+void flushStepperState(STEPPER *motor)
+{
+    if(motor->stateDirty && !motor->moving && getMillis() - motor->idleMs >= STEPPER_SAVE_IDLE_MS)
+        saveStepperState(motor) ;
+}
+
+//invalidateStepperState() clears the stored state so a reset during a session of moves forces homing
+//Only the first move of a session writes, later moves find the state already cleared
+void invalidateStepperState(STEPPER *motor)
+{
+    if(motor->stateSaved)
+    {
+        writeEeprom(motor->eepromAddress, 0)    ;
+        motor->stateSaved = false   ;
+    }
+}
+
+//restoreStepperState() loads position and phase, returns false if the stored state is not valid
+bool restoreStepperState(STEPPER *motor)
+{
+    uint32_t state = readEeprom(motor->eepromAddress)   ;
+    uint8_t  stored_phase       = state >> 16   ;
+    uint8_t  stored_position    = state >> 8    ;
+
+    if((state >> 24) != STATE_MAGIC || stored_phase > 3 || (uint8_t)state != (uint8_t)~(STATE_MAGIC + stored_phase + stored_position))
+        return false    ;
+
+    motor->phase        = stored_phase      ;
+    motor->position     = stored_position   ;
+    motor->positionKnown= true              ;
+    motor->stateSaved   = true              ;
+    //energize the stored phase so the rotor holds its detent
+    applyPhase(motor, motor->phase) ;
+    return true ;
+}
+
+//saveStepperProfile() records the motion profile, for example after characterization
+void saveStepperProfile(STEPPER *motor)
+{
+    if(motor->eepromAddress == STEPPER_NO_EEPROM)
+        return  ;
+    writeEeprom(motor->eepromAddress + 1, ((uint32_t)PROFILE_MAGIC << 24) | ((uint32_t)motor->profile.rampSteps << 16) | (motor->profile.stepPeriodUs & 0xFFFF)) ;
+    writeEeprom(motor->eepromAddress + 2, motor->profile.startPeriodUs) ;
+}
+
+//restoreStepperProfile() loads a stored motion profile, returns false and keeps the default if none is stored
+bool restoreStepperProfile(STEPPER *motor)
+{
+    uint32_t profile = readEeprom(motor->eepromAddress + 1) ;
+    uint32_t start   = readEeprom(motor->eepromAddress + 2) ;
+
+    if((profile >> 24) != PROFILE_MAGIC || (profile & 0xFFFF) == 0 || start == 0 || start > 0xFFFF)
+        return false    ;
+
+    motor->profile.stepPeriodUs     = profile & 0xFFFF          ;
+    motor->profile.rampSteps        = (profile >> 16) & 0xFF    ;
+    motor->profile.startPeriodUs    = start                     ;
+    return true ;
+}
+
+//applyPhase() energizes the coil of one phase and releases the others
+void applyPhase(STEPPER *motor, uint8_t phase_value)
+{
+    const STEPPER_PINS *pins = motor->pins  ;
+    GPIO_REG(pins->portBase, (pins->phaseMask[0] | pins->phaseMask[1] | pins->phaseMask[2] | pins->phaseMask[3]) << 2) = pins->phaseMask[phase_value & 3] ;
+}
+
+//stepCw() drives the motor one step in clock wise direction
+void stepCw(STEPPER *motor)
+{
+    motor->phase = (motor->phase + 1) & 3   ;
+    applyPhase(motor, motor->phase)         ;
+    motor->position++                       ;
+}
+
+//stepCcw() drives the motor one step in anti clock wise direction
+void stepCcw(STEPPER *motor)
+{
+    motor->phase = (motor->phase - 1) & 3   ;
+    applyPhase(motor, motor->phase)         ;
+    motor->position--                       ;
+}
+
+//setStepperPosition() used to setup the stepper motor position
+void setStepperPosition(STEPPER *motor, uint8_t position_value)
+{
+    motor->position = position_value    ;
+}
+
+//stepPeriod() returns the period of step k in a move of count steps, ramping at both ends
+uint32_t stepPeriod(const MOTION_PROFILE *profile, uint16_t k, uint16_t count)
+{
+    uint16_t ramp = k < (count - 1 - k) ? k : (count - 1 - k)   ;
+
+    if(ramp < profile->rampSteps && profile->startPeriodUs > profile->stepPeriodUs)
+        return profile->startPeriodUs - ((profile->startPeriodUs - profile->stepPeriodUs) * ramp) / profile->rampSteps  ;
+    return profile->stepPeriodUs    ;
+}
+
+//setStepperDmaMode() selects uDMA step generation for moves of this motor
+void setStepperDmaMode(STEPPER *motor, bool enable)
+{
+    motor->dmaMode = enable ;
+}
+
+//periodGcd() returns the greatest common divisor of two periods
+uint32_t periodGcd(uint32_t a, uint32_t b)
+{
+    uint32_t r  ;
+    while(b != 0)
+    {
+        r = a % b   ;
+        a = b       ;
+        b = r       ;
+    }
+    return a    ;
+}
+
+//startStepperDma() streams a precomputed phase table to the coil pins, returns false if the move does not fit
+//The slot is the largest that divides every step period of the move, so each step keeps its exact period
+bool startStepperDma(STEPPER *motor, int16_t steps)
+{
+    const STEPPER_PINS *pins = motor->pins  ;
+    volatile uint32_t *data  = &GPIO_REG(pins->portBase, (pins->phaseMask[0] | pins->phaseMask[1] | pins->phaseMask[2] | pins->phaseMask[3]) << 2)  ;
+    uint16_t count      = steps < 0 ? -steps : steps            ;
+    uint16_t slots      = 0 , k , n , first                     ;
+    uint8_t  next_phase = motor->phase                          ;
+    uint32_t slot_us    = 0                                     ;
+    uint32_t control    = UDMA_CHCTL_DSTINC_NONE | UDMA_CHCTL_DSTSIZE_8 | UDMA_CHCTL_SRCINC_8 | UDMA_CHCTL_SRCSIZE_8 | UDMA_CHCTL_ARBSIZE_1  ;
+
+    if(dma_owner != 0)
+        return false    ;
+
+    //slot dividing every period, each step then fills at least one slot
+    for(k = 0 ; k < count ; k++)
+        slot_us = periodGcd(stepPeriod(&motor->profile, k, count), slot_us)   ;
+    if(slot_us < DMA_MIN_SLOT_US)
+        return false    ;
+
+    //expand each step into slots of its profile period
+    for(k = 0 ; k < count ; k++)
+    {
+        next_phase = (steps > 0 ? next_phase + 1 : next_phase - 1) & 3   ;
+        for(n = stepPeriod(&motor->profile, k, count) / slot_us ; n > 0 ; n--)
+        {
+            if(slots == DMA_SLOTS)
+                return false    ;
+            step_table[slots++] = pins->phaseMask[next_phase]  ;
+        }
+    }
+    if(slots == 0)
+        return false    ;
+
+    //primary structure covers the first 1024 slots, alternate the remainder
+    first = slots > 1024 ? 1024 : slots ;
+    if(slots > 1024)
+    {
+        setUdmaTransfer(UDMA_CH_TIMER0A, false, &step_table[first - 1], data, control | ((uint32_t)(first - 1) << UDMA_CHCTL_XFERSIZE_S) | UDMA_CHCTL_XFERMODE_PINGPONG)  ;
+        setUdmaTransfer(UDMA_CH_TIMER0A, true, &step_table[slots - 1], data, control | ((uint32_t)(slots - first - 1) << UDMA_CHCTL_XFERSIZE_S) | UDMA_CHCTL_XFERMODE_BASIC) ;
+    }
+    else
+        setUdmaTransfer(UDMA_CH_TIMER0A, false, &step_table[first - 1], data, control | ((uint32_t)(first - 1) << UDMA_CHCTL_XFERSIZE_S) | UDMA_CHCTL_XFERMODE_BASIC) ;
+
+    dma_owner           = motor             ;
+    motor->dmaPhase     = next_phase        ;
+    enableUdmaChannel(UDMA_CH_TIMER0A)      ;
+
+    //Timer 0A timeouts request one slot each
+    SYSCTL_RCGCTIMER_R  |= SYSCTL_RCGCTIMER_R0                  ;
     _delay_cycles(3);
+    TIMER0_CTL_R        &= ~TIMER_CTL_TAEN                      ;// turn-off timer before reconfiguring
+    TIMER0_CFG_R        = TIMER_CFG_32_BIT_TIMER                ;// configure as 32-bit timer
+    TIMER0_TAMR_R       = TIMER_TAMR_TAMR_PERIOD                ;// periodic mode, count down
+    TIMER0_TAILR_R      = getSystemClockHz() / 1000000 * slot_us - 1 ;// slot period in system clocks
+    TIMER0_IMR_R        = 0                                     ;// uDMA request only, no interrupt
+    TIMER0_ICR_R        = TIMER_ICR_TATOCINT                    ;
+    TIMER0_CTL_R        |= TIMER_CTL_TAEN                       ;// turn-on timer
+    return true ;
+}
 
-    //Configure Port E
+//startStepperSteps() starts a relative move, steps are issued by serviceStepper() or streamed by uDMA
+//Only homing may move a motor whose position is unknown
+void startStepperSteps(STEPPER *motor, int16_t steps)
+{
+    while(isStepperBusy(motor))
+        runSteppers(&motor, 1)  ;
+    if(steps == 0 || !(motor->positionKnown || motor->homing))
+        return  ;
+
+    invalidateStepperState(motor)   ;
+    motor->target   = motor->position + steps       ;
+    motor->stepIndex= 0                             ;
+    motor->stepCount= steps < 0 ? -steps : steps    ;
+    motor->forward  = steps > 0                     ;
+    motor->dwellUs  = 0                             ;
+    motor->moving   = true                          ;
+    motor->dmaActive= motor->dmaMode && startStepperDma(motor, steps)   ;
+}
 
-    GPIO_PORTE_DIR_R    |=  PE2_GREEN_MASK | PE3_YELLOW_MASK | PE4_BLACK_MASK | PE5_WHITE_MASK       ;   //configured as outputs
-    GPIO_PORTE_DR2R_R   |=  PE2_GREEN_MASK | PE3_YELLOW_MASK | PE4_BLACK_MASK | PE5_WHITE_MASK       ;   //setting output current to 2mA
-    GPIO_PORTE_DEN_R    |=  PE2_GREEN_MASK | PE3_YELLOW_MASK | PE4_BLACK_MASK | PE5_WHITE_MASK       ;   //Port E data enable
+//limitStepperSteps() shortens a relative move so it ends between position 0 and the home position
+//Positions past home run into the mechanical stop, positions below 0 would wrap
+int16_t limitStepperSteps(STEPPER *motor, int16_t steps)
+{
+    int16_t highest = motor->homeSteps - motor->homeBackoff  ;
+    int16_t target  = (int16_t)motor->position + steps      ;
 
-    //calling home function
-    home();
+    if(target < 0)
+        target = 0          ;
+    if(target > highest)
+        target = highest    ;
+    return target - motor->position ;
 }
 
-// Apply phase function which drives the stepper motor
-void Apply_Phase(uint8_t phase_value)
+//startStepperMove() starts a move to an absolute step position, homing first if the position is unknown
+void startStepperMove(STEPPER *motor, uint8_t target_position)
 {
-    switch(phase_value)
+    if(!motor->positionKnown)
+        homeStepper(motor)  ;
+    startStepperSteps(motor, (int16_t)target_position - motor->position) ;
+}
+
+//isStepperBusy() returns true while a move is running
+bool isStepperBusy(STEPPER *motor)
+{
+    return motor->moving    ;
+}
+
+//finishStepperMove() ends a move, flushStepperState() stores the position once the session is over
+void finishStepperMove(STEPPER *motor)
+{
+    motor->moving = false   ;
+    if(!motor->homing)
     {
-    case 0:
-        PE4_BLACK           = 1     ;
-        PE5_WHITE           = 0     ;
-        PE3_YELLOW          = 0     ;
-        PE2_GREEN           = 0     ;
-        break;
-    case 1:
-        PE3_YELLOW          = 1     ;
-        PE2_GREEN           = 0     ;
-        PE4_BLACK           = 0     ;
-        PE5_WHITE           = 0     ;
-        break;
-    case 2:
-        PE4_BLACK           = 0     ;
-        PE5_WHITE           = 1     ;
-        PE3_YELLOW          = 0     ;
-        PE2_GREEN           = 0     ;
-        break;
-    case 3:
-        PE2_GREEN           = 1     ;
-        PE4_BLACK           = 0     ;
-        PE5_WHITE           = 0     ;
-        PE3_YELLOW          = 0     ;
-        break;
+        motor->stateDirty   = true          ;
+        motor->idleMs       = getMillis()   ;
     }
-    waitMicrosecond(10000);
 }
 
-//stepCw() drives the motor in clock wise direction
-void stepCw()
+//serviceStepper() advances a move by elapsed_us, returns true while the move is running
+bool serviceStepper(STEPPER *motor, uint32_t elapsed_us)
 {
-      phase = (phase + 1)%4           ;
-      Apply_Phase(phase)              ;
-      position++                      ;
+    if(!motor->moving)
+        return false    ;
+
+    if(motor->dmaActive)
+    {
+        if(isUdmaChannelEnabled(UDMA_CH_TIMER0A))
+            return true ;
+        TIMER0_CTL_R    &= ~TIMER_CTL_TAEN  ;
+        motor->phase    = motor->dmaPhase   ;
+        motor->position = motor->target     ;
+        motor->dmaActive= false             ;
+        dma_owner       = 0                 ;
+        finishStepperMove(motor)            ;
+        return false    ;
+    }
+
+    //hold the present phase until its period has elapsed
+    if(motor->dwellUs > elapsed_us)
+    {
+        motor->dwellUs -= elapsed_us    ;
+        return true ;
+    }
+    motor->dwellUs = 0  ;
+
+    if(motor->stepIndex == motor->stepCount)
+    {
+        finishStepperMove(motor)    ;
+        return false    ;
+    }
+
+    if(motor->forward)
+        stepCw(motor)   ;
+    else
+        stepCcw(motor)  ;
+    motor->dwellUs = stepPeriod(&motor->profile, motor->stepIndex, motor->stepCount)    ;
+    motor->stepIndex++  ;
+    return true ;
 }
 
-//stepCcw() drives the motor in anti clock wise direction
-void stepCcw()
+//stopStepper() ends a move after the present step, the position stays exact
+//A uDMA move runs to its end since its position is only known on completion
+void stopStepper(STEPPER *motor)
 {
-      phase = (uint8_t)(phase - 1)%4  ;
-      Apply_Phase(phase)              ;
-      position--                      ;
+    if(!motor->moving || motor->dmaActive)
+        return  ;
+    motor->stepCount    = motor->stepIndex  ;
+    motor->target       = motor->position   ;
 }
 
-//setPosition() used to setup the stepper motor position
-void setPosition(uint8_t position_value )
+//runSteppers() steps every listed motor concurrently, each on its own profile, until all have arrived or the operation is cancelled
+void runSteppers(STEPPER *motors[], uint8_t count)
 {
-    position = position_value       ;
+    uint8_t k   ;
+    bool busy = true    ;
+
+    while(busy)
+    {
+        busy = false    ;
+        if(pollCancel())
+        {
+            for(k = 0 ; k < count ; k++)
+                stopStepper(motors[k])  ;
+        }
+        for(k = 0 ; k < count ; k++)
+            busy |= serviceStepper(motors[k], STEPPER_TICK_US)  ;
+        if(busy)
+            waitMicrosecond(STEPPER_TICK_US)    ;
+    }
 }
 
-//home() is used to center the reference tube
-void home()
+//moveStepper() moves to an absolute step position and waits for the move to finish
+void moveStepper(STEPPER *motor, uint8_t target_position)
+{
+    startStepperMove(motor, target_position)    ;
+    runSteppers(&motor, 1)                      ;
+}
+
+//homeStepper() drives the motor into its stop and backs off to the home position
+//Moves before homing are not stored, their position is counted from before the stall
+void homeStepper(STEPPER *motor)
 {
-    uint8_t find_position = 0       ;
-    while(find_position <200)
+    motor->homing       = true  ;
+    motor->stateDirty   = false ;
+    startStepperSteps(motor, motor->homeSteps)  ;
+    runSteppers(&motor, 1)                      ;
+    if(!isCancelRequested())
     {
-        stepCw()                    ;
-        find_position++             ;
+        startStepperSteps(motor, -(int16_t)motor->homeBackoff)  ;
+        runSteppers(&motor, 1)                  ;
     }
+    motor->homing = false   ;
 
-    for(i=0 ; i<5 ;i++)
+    //the stored state stays invalid after an aborted homing so the next start homes again
+    //and the position is unknown so the next move homes first
+    if(isCancelRequested())
     {
-        stepCcw()   ;
-        find_position--  ;
+        motor->positionKnown = false    ;
+        return  ;
     }
 
-    setPosition(find_position)  ;
+    setStepperPosition(motor, motor->homeSteps - motor->homeBackoff)  ;
+    motor->positionKnown = true ;
+    saveStepperState(motor) ;
+}
+
+//home() is used to center the reference tube
+void home()
+{
+    homeStepper(&carousel)  ;
 }
 
 //goto_tube() changes the position of the tube based on the tube_value() input
 void goto_tube(uint8_t tube_value)
 {
-    switch(tube_value)
-       {
-       case 0:
-           Present_tube_pos   = position    ;
-           Req_tube_pos       = 195         ;//197
-           if(Req_tube_pos > Present_tube_pos)
-           {
-               for(i=0;i<(Req_tube_pos-Present_tube_pos);i++)
-               {
-                   stepCw();
-               }
-           }
-           else
-           {
-            for (i = 0; i < (Present_tube_pos-Req_tube_pos); i++)
-            {
-                stepCcw();
-            }
-           }
-           break;
-
-       case 1:
-           Present_tube_pos   = position    ;
-           Req_tube_pos       = 28;//30         ;
-           if(Req_tube_pos > Present_tube_pos)
-           {
-               for(i=0;i<(Req_tube_pos-Present_tube_pos);i++)
-               {
-                   stepCw();
-               }
-           }
-           else
-           {
-            for (i = 0; i < (Present_tube_pos-Req_tube_pos); i++)
-            {
-                stepCcw();
-            }
-           }
-           break;
-
-       case 2:
-           Present_tube_pos   = position    ;
-           Req_tube_pos       = 62;//65         ;
-           if(Req_tube_pos > Present_tube_pos)
-           {
-               for(i=0;i<(Req_tube_pos-Present_tube_pos);i++)
-               {
-                   stepCw();
-               }
-           }
-           else
-           {
-            for (i = 0; i < (Present_tube_pos-Req_tube_pos); i++)
-            {
-                stepCcw();
-            }
-           }
-           break;
-
-       case 3:
-           Present_tube_pos   = position    ;
-           Req_tube_pos       = 96;//98         ;
-           if(Req_tube_pos > Present_tube_pos)
-           {
-               for(i=0;i<(Req_tube_pos-Present_tube_pos);i++)
-               {
-                   stepCw();
-               }
-           }
-           else
-           {
-            for (i = 0; i < (Present_tube_pos-Req_tube_pos); i++)
-            {
-                stepCcw();
-            }
-           }
-           break;
-
-       case 4:
-           Present_tube_pos   = position    ;
-           Req_tube_pos       = 129;//131         ;
-           if(Req_tube_pos > Present_tube_pos)
-           {
-               for(i=0;i<(Req_tube_pos-Present_tube_pos);i++)
-               {
-                   stepCw();
-               }
-           }
-           else
-           {
-            for (i = 0; i < (Present_tube_pos-Req_tube_pos); i++)
-            {
-                stepCcw();
-            }
-           }
-           break;
-
-
-       case 5:
-           Present_tube_pos   = position    ;
-           Req_tube_pos       = 162;//161;//164         ;
-           if(Req_tube_pos > Present_tube_pos)
-           {
-               for(i=0;i<(Req_tube_pos-Present_tube_pos);i++)
-               {
-                   stepCw();
-               }
-           }
-           else
-           {
-            for (i = 0; i < (Present_tube_pos-Req_tube_pos); i++)
-            {
-                stepCcw();
-            }
-           }
-           break;
-       }
+    if(tube_value >= carousel.tubeCount)
+        return  ;
+    moveStepper(&carousel, carousel.tubePosition[tube_value])   ;
 }
 
+//planTubeVisits() orders tubes to minimize total travel from the present position and returns the count
+//Moves never wrap past the home stop, so the shortest tour visits the nearer end first and sweeps to the other end
+uint8_t planTubeVisits(STEPPER *motor, uint8_t tubes[], uint8_t count)
+{
+    const uint8_t *tube_position = motor->tubePosition  ;
+    uint8_t position = motor->position  ;
+    uint8_t j , k , temp , lowest , highest   ;
 
+    //insertion sort by step position, ascending
+    for(j = 1 ; j < count ; j++)
+    {
+        temp = tubes[j]     ;
+        for(k = j ; k > 0 && tube_position[tubes[k - 1]] > tube_position[temp] ; k--)
+            tubes[k] = tubes[k - 1] ;
+        tubes[k] = temp     ;
+    }
+    if(count < 2)
+        return count    ;
+
+    lowest  = tube_position[tubes[0]]           ;
+    highest = tube_position[tubes[count - 1]]   ;
+
+    //sweep downwards if the highest tube is the nearer end
+    if((position > highest ? position - highest : highest - position) < (position > lowest ? position - lowest : lowest - position))
+    {
+        for(j = 0 , k = count - 1 ; j < k ; j++ , k--)
+        {
+            temp        = tubes[j]  ;
+            tubes[j]    = tubes[k]  ;
+            tubes[k]    = temp      ;
+        }
+    }
+    return count    ;
+}
@@ -8,17 +8,91 @@
 #ifndef STEPPERMOTOR_H_
 #define STEPPERMOTOR_H_
 
+#include <stdint.h>
+#include <stdbool.h>
+
 //#define DEBUG
 
+#define STEPPER_NO_EEPROM   0xFFFF      // eepromAddress of a motor whose state is not persisted
+#define STEPPER_TICK_US     500         // runSteppers() service interval
+#define STEPPER_SAVE_IDLE_MS 2000       // idle time that ends a session of moves, its final state is then stored
+
+// Coil pins of one motor, all on the same GPIO port
+typedef struct _STEPPER_PINS
+{
+    uint32_t portBase           ;   // GPIO port base address (APB)
+    uint32_t rcgcMask           ;   // SYSCTL_RCGCGPIO bit of the port
+    uint8_t  phaseMask[4]       ;   // pin energized in each phase
+} STEPPER_PINS;
+
+// Step timing of one motor
+typedef struct _MOTION_PROFILE
+{
+    uint32_t stepPeriodUs       ;   // cruise step period
+    uint32_t startPeriodUs      ;   // period of the first and last step of a move
+    uint8_t  rampSteps          ;   // steps to ramp between start and cruise periods
+} MOTION_PROFILE;
+
+// Configuration and state of one motor
+typedef struct _STEPPER
+{
+    const STEPPER_PINS *pins    ;
+    MOTION_PROFILE  profile     ;
+    const uint8_t   *tubePosition;  // step position of each sample slot
+    uint8_t         tubeCount   ;
+    uint8_t         homeSteps   ;   // steps driven into the mechanical stop
+    uint8_t         homeBackoff ;   // steps back from the stop to the home position
+    uint16_t        eepromAddress;  // stored state word followed by two profile words, or STEPPER_NO_EEPROM
+
+    uint8_t         phase       ;
+    uint8_t         position    ;
+    uint8_t         target      ;
+    uint8_t         dmaPhase    ;
+    uint16_t        stepIndex   ;
+    uint16_t        stepCount   ;
+    uint32_t        dwellUs     ;
+    bool            forward     ;
+    bool            moving      ;
+    bool            homing      ;
+    bool            positionKnown;  // homed or restored, cleared by an aborted homing
+    bool            dmaMode     ;
+    bool            dmaActive   ;
+    bool            stateSaved  ;   // the stored state word is valid
+    bool            stateDirty  ;   // moves have ended since the state was stored
+    uint32_t        idleMs      ;   // getMillis() when the last move ended
+} STEPPER;
+
+extern STEPPER carousel ;
+
 //-----------------------------------------------------------------------------
 // Subroutines
 //-----------------------------------------------------------------------------
 
-void initStepperMotor()                             ;
-void Apply_Phase(uint8_t phase_value)               ;
-void stepCw()                                       ;
-void stepCcw()                                      ;
-void setPosition(uint8_t position_value )           ;
-void home()                                         ;
-void goto_tube(uint8_t tube_value)                  ;
+void initStepper(STEPPER *motor)                                        ;
+void initStepperMotor()                                                 ;
+void saveStepperState(STEPPER *motor)                                   ;
+void invalidateStepperState(STEPPER *motor)                             ;
+void flushStepperState(STEPPER *motor)                                  ;
+bool restoreStepperState(STEPPER *motor)                                ;
+void saveStepperProfile(STEPPER *motor)                                 ;
+bool restoreStepperProfile(STEPPER *motor)                              ;
+void applyPhase(STEPPER *motor, uint8_t phase_value)                    ;
+void stepCw(STEPPER *motor)                                             ;
+void stepCcw(STEPPER *motor)                                            ;
+void setStepperPosition(STEPPER *motor, uint8_t position_value)         ;
+uint32_t stepPeriod(const MOTION_PROFILE *profile, uint16_t k, uint16_t count)  ;
+void setStepperDmaMode(STEPPER *motor, bool enable)                     ;
+bool startStepperDma(STEPPER *motor, int16_t steps)                     ;
+void startStepperSteps(STEPPER *motor, int16_t steps)                   ;
+int16_t limitStepperSteps(STEPPER *motor, int16_t steps)                ;
+void startStepperMove(STEPPER *motor, uint8_t target_position)          ;
+bool isStepperBusy(STEPPER *motor)                                      ;
+bool serviceStepper(STEPPER *motor, uint32_t elapsed_us)                ;
+void stopStepper(STEPPER *motor)                                        ;
+void runSteppers(STEPPER *motors[], uint8_t count)                      ;
+void moveStepper(STEPPER *motor, uint8_t target_position)               ;
+void homeStepper(STEPPER *motor)                                        ;
+void home()                                                             ;
+void goto_tube(uint8_t tube_value)                                      ;
+uint8_t planTubeVisits(STEPPER *motor, uint8_t tubes[], uint8_t count)  ;
 #endif
@@ -0,0 +1,64 @@
+// Cancellation Library
+// Mourya
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+// Long operations (calibration, homing, measurement, batch runs) call pollCancel()
+// from their loops, the poll hook reads the IR and UART inputs while they run
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "cancel.h"
+
+//-----------------------------------------------------------------------------
+// Global variables
+//-----------------------------------------------------------------------------
+
+volatile bool cancel_requested      = false ;   // set from the poll hook or an interrupt
+void        (*cancel_poll)(void)    = 0     ;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+//setCancelPoll() sets the function that reads the inputs while an operation is running
+void setCancelPoll(void (*poll)(void))
+{
+    cancel_poll = poll  ;
+}
+
+//requestCancel() asks the running operation to stop
+void requestCancel(void)
+{
+    cancel_requested = true ;
+}
+
+//isCancelRequested() returns the request without reading the inputs
+bool isCancelRequested(void)
+{
+    return cancel_requested ;
+}
+
+//pollCancel() reads the inputs and returns true once the running operation should stop
+bool pollCancel(void)
+{
+    if(!cancel_requested && cancel_poll != 0)
+        cancel_poll()   ;
+    return cancel_requested ;
+}
+
+//clearCancel() is called before an operation starts
+void clearCancel(void)
+{
+    cancel_requested = false    ;
+}
@@ -0,0 +1,31 @@
+// Cancellation Library
+// Mourya
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef CANCEL_H_
+#define CANCEL_H_
+
+#include <stdbool.h>
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void setCancelPoll(void (*poll)(void))  ;
+void requestCancel(void)                ;
+bool isCancelRequested(void)            ;
+bool pollCancel(void)                   ;
+void clearCancel(void)                  ;
+
+#endif
@@ -24,6 +24,8 @@
 // Global variables
 //-----------------------------------------------------------------------------
 
+uint32_t systemClockHz = 16000000;              // precision internal oscillator after reset
+
 //-----------------------------------------------------------------------------
 // Subroutines
 //-----------------------------------------------------------------------------
@@ -33,4 +35,11 @@ void initSystemClockTo40Mhz(void)
 {
     // Configure HW to work with 16 MHz XTAL, PLL enabled, sysdivider of 5, creating system clock of 40 MHz
     SYSCTL_RCC_R = SYSCTL_RCC_XTAL_16MHZ | SYSCTL_RCC_OSCSRC_MAIN | SYSCTL_RCC_USESYSDIV | (4 << SYSCTL_RCC_SYSDIV_S);
+    systemClockHz = 40000000;
+}
+
+// Returns the system clock frequency in Hz, as set by the last clock initialization
+uint32_t getSystemClockHz(void)
+{
+    return systemClockHz;
 }
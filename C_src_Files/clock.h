@@ -19,10 +19,13 @@
 #ifndef CLOCK_H_
 #define CLOCK_H_
 
+#include <stdint.h>
+
 //-----------------------------------------------------------------------------
 // Subroutines
 //-----------------------------------------------------------------------------
 
 void initSystemClockTo40Mhz(void);
+uint32_t getSystemClockHz(void);
 
 #endif
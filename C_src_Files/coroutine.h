@@ -0,0 +1,48 @@
+// Stackless Coroutine Library
+// Mourya
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+// Protothread-style coroutines, a step function keeps its linear structure and returns at every wait point
+// The function returns true while the coroutine is running and false once it has ended
+// Each call resumes at the line it last left through a switch on the saved line number, so
+//   - locals do not survive a wait, keep the state in the structure holding the COROUTINE
+//   - the body must not contain a switch statement of its own
+//   - one wait per source line
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef COROUTINE_H_
+#define COROUTINE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "tick.h"
+
+typedef struct _COROUTINE
+{
+    uint16_t line   ;   // resume point, 0 at the start
+    uint32_t start  ;   // getMicros() when the present delay began
+    uint32_t delayUs;   // length of the present delay, 0 while not delaying
+} COROUTINE;
+
+#define CO_INIT(co)             ((co)->line = 0 , (co)->delayUs = 0)
+#define CO_BEGIN(co)            switch((co)->line) { case 0:
+#define CO_END(co)              } (co)->line = 0 ; return false
+#define CO_EXIT(co)             do { (co)->line = 0 ; return false ; } while(0)
+#define CO_YIELD(co)            do { (co)->line = __LINE__ ; return true ; case __LINE__: ; } while(0)
+#define CO_WAIT_UNTIL(co, cond) do { (co)->line = __LINE__ ; case __LINE__: if(!(cond)) return true ; } while(0)
+#define CO_DELAY_US(co, us)     do { (co)->start = getMicros() ; (co)->delayUs = (us) ; CO_WAIT_UNTIL(co, getMicros() - (co)->start >= (co)->delayUs) ; (co)->delayUs = 0 ; } while(0)
+
+// Time left in the present delay, 0 if the coroutine yielded or is not delaying, so a caller can sleep until it is due
+#define CO_WAIT_US(co)          ((co)->delayUs > getMicros() - (co)->start ? (co)->delayUs - (getMicros() - (co)->start) : 0)
+
+#endif
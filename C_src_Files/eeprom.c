@@ -0,0 +1,55 @@
+// EEPROM Library
+// Mourya
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    -
+
+// Hardware configuration:
+// 2 KB internal EEPROM (32 blocks of 16 words)
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "tm4c123gh6pm.h"
+#include "eeprom.h"
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// Initialize EEPROM, returns false if the module reports a failed program or erase
+bool initEeprom()
+{
+    // Enable clocks
+    SYSCTL_RCGCEEPROM_R |= SYSCTL_RCGCEEPROM_R0;
+    _delay_cycles(6);
+
+    // Wait for the power-on copy/erase to finish (Refer 8.2.4.2 in data sheet)
+    while (EEPROM_EEDONE_R & EEPROM_EEDONE_WORKING);
+    return !(EEPROM_EESUPP_R & (EEPROM_EESUPP_PRETRY | EEPROM_EESUPP_ERETRY));
+}
+
+// Blocking function that writes one 32-bit word
+void writeEeprom(uint16_t add, uint32_t data)
+{
+    EEPROM_EEBLOCK_R = add >> 4;                     // select 16-word block
+    EEPROM_EEOFFSET_R = add & 0xF;                   // select word in block
+    EEPROM_EERDWR_R = data;                          // start write
+    while (EEPROM_EEDONE_R & EEPROM_EEDONE_WORKING); // wait until programmed
+}
+
+// Returns one 32-bit word
+uint32_t readEeprom(uint16_t add)
+{
+    EEPROM_EEBLOCK_R = add >> 4;
+    EEPROM_EEOFFSET_R = add & 0xF;
+    return EEPROM_EERDWR_R;
+}
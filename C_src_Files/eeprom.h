@@ -0,0 +1,36 @@
+// EEPROM Library
+// Mourya
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    -
+
+// Hardware configuration:
+// 2 KB internal EEPROM (32 blocks of 16 words)
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef EEPROM_H_
+#define EEPROM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// EEPROM word addresses (block = address / 16, offset = address % 16)
+#define EEPROM_STEPPER_STATE    0       // state word, then 2 motion profile words
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+bool initEeprom()                                   ;
+void writeEeprom(uint16_t add, uint32_t data)       ;
+uint32_t readEeprom(uint16_t add)                   ;
+
+#endif
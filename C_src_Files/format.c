@@ -0,0 +1,86 @@
+// Number Formatting Library
+// Mourya
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+// Integer and fixed-point decimal conversion for the result path, replaces sprintf()
+// Widths pad with spaces on the left like printf("%4u"), no NULL is written by the format functions
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "uart0.h"
+#include "format.h"
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+//formatUint() writes value right aligned in at least width characters, returns the length
+uint8_t formatUint(char *out, uint32_t value, uint8_t width)
+{
+    char    digits[10]  ;
+    uint8_t count = 0 , length = 0 ;
+
+    do
+    {
+        digits[count++] = '0' + value % 10  ;
+        value /= 10                         ;
+    } while(value != 0) ;
+
+    for( ; width > count ; width--)
+        out[length++] = ' ' ;
+    while(count > 0)
+        out[length++] = digits[--count] ;
+    return length   ;
+}
+
+//formatFixed() writes value / 10^decimals with all decimals, as printf("%width.decimalsf") would, returns the length
+uint8_t formatFixed(char *out, int32_t value, uint8_t decimals, uint8_t width)
+{
+    char     digits[12] ;   // sign, 10 digits, point
+    uint32_t magnitude  = value < 0 ? -(uint32_t)value : (uint32_t)value ;
+    uint8_t  minimum    = decimals > 0 ? decimals + 2 : 1 ;   // at least one integer digit
+    uint8_t  count = 0 , length = 0 ;
+
+    do
+    {
+        digits[count++] = '0' + magnitude % 10  ;
+        magnitude /= 10                         ;
+        if(count == decimals)
+            digits[count++] = '.'   ;
+    } while(magnitude != 0 || count < minimum)  ;
+    if(value < 0)
+        digits[count++] = '-'   ;
+
+    for( ; width > count ; width--)
+        out[length++] = ' ' ;
+    while(count > 0)
+        out[length++] = digits[--count] ;
+    return length   ;
+}
+
+//putUintUart0() writes an unsigned value, width up to FORMAT_MAX_WIDTH
+void putUintUart0(uint32_t value, uint8_t width)
+{
+    char text[FORMAT_MAX_WIDTH + 1] ;
+    text[formatUint(text, value, width)] = '\0' ;
+    putsUart0(text) ;
+}
+
+//putFixedUart0() writes a fixed-point value, width up to FORMAT_MAX_WIDTH
+void putFixedUart0(int32_t value, uint8_t decimals, uint8_t width)
+{
+    char text[FORMAT_MAX_WIDTH + 1] ;
+    text[formatFixed(text, value, decimals, width)] = '\0'  ;
+    putsUart0(text) ;
+}
@@ -0,0 +1,32 @@
+// Number Formatting Library
+// Mourya
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef FORMAT_H_
+#define FORMAT_H_
+
+#include <stdint.h>
+
+#define FORMAT_MAX_WIDTH    20      // widest padded field of the put functions
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+uint8_t formatUint(char *out, uint32_t value, uint8_t width)                    ;
+uint8_t formatFixed(char *out, int32_t value, uint8_t decimals, uint8_t width)  ;
+void putUintUart0(uint32_t value, uint8_t width)                                ;
+void putFixedUart0(int32_t value, uint8_t decimals, uint8_t width)              ;
+
+#endif
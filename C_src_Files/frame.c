@@ -0,0 +1,119 @@
+// Binary Frame Library
+// Mourya
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+// Records for the binary mode of the UART0 protocol
+// CRC16 is CCITT (polynomial 0x1021, initial value 0xFFFF) over type, sequence, tag and payload
+// The tag is the sequence ID of the command the record answers, 0 if it was not tagged
+// COBS removes every 0 byte from the record so a 0 always marks the end of a frame
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "uart0.h"
+#include "frame.h"
+
+#define FRAME_RECORD_MAX    (FRAME_MAX_PAYLOAD + 6)                 // type, sequence, tag, payload, CRC
+#define FRAME_ENCODED_MAX   (FRAME_RECORD_MAX + FRAME_RECORD_MAX / 254 + 1)
+
+//-----------------------------------------------------------------------------
+// Global variables
+//-----------------------------------------------------------------------------
+
+uint8_t  frame_seq  = 0 ;   // sequence number of the next record, lets the host detect lost frames
+uint16_t frame_tag  = 0 ;   // tag of the command being answered
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+//crc16() continues a CRC16-CCITT over size bytes, start with 0xFFFF
+uint16_t crc16(const uint8_t *data, uint16_t size, uint16_t crc)
+{
+    uint8_t bit ;
+    while(size-- > 0)
+    {
+        crc ^= (uint16_t)*data++ << 8   ;
+        for(bit = 0 ; bit < 8 ; bit++)
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1   ;
+    }
+    return crc  ;
+}
+
+//encodeCobs() replaces the 0 bytes of size bytes with the distance to the next one, returns the encoded length
+uint16_t encodeCobs(const uint8_t *in, uint16_t size, uint8_t *out)
+{
+    uint16_t read = 0 , write = 1 , code_index = 0 ;
+    uint8_t  code = 1 ;
+
+    while(read < size)
+    {
+        if(in[read] == 0)
+        {
+            out[code_index] = code  ;
+            code            = 1     ;
+            code_index      = write++   ;
+            read++  ;
+        }
+        else
+        {
+            out[write++] = in[read++]   ;
+            if(++code == 0xFF)
+            {
+                out[code_index] = code  ;
+                code            = 1     ;
+                code_index      = write++   ;
+            }
+        }
+    }
+    out[code_index] = code  ;
+    return write    ;
+}
+
+//putFrameUint16() stores value little endian in a payload, returns the next index
+uint8_t putFrameUint16(uint8_t *payload, uint8_t index, uint16_t value)
+{
+    payload[index++] = value & 0xFF ;
+    payload[index++] = value >> 8   ;
+    return index    ;
+}
+
+//setFrameTag() sets the command tag carried by the following records
+void setFrameTag(uint16_t tag)
+{
+    frame_tag = tag ;
+}
+
+//sendFrame() queues one record on UART0, payloads are limited to FRAME_MAX_PAYLOAD bytes
+void sendFrame(uint8_t type, const uint8_t *payload, uint8_t size)
+{
+    uint8_t  record[FRAME_RECORD_MAX]   ;
+    uint8_t  encoded[FRAME_ENCODED_MAX] ;
+    uint16_t crc , length , k ;
+
+    if(size > FRAME_MAX_PAYLOAD)
+        return  ;
+
+    record[0] = type        ;
+    record[1] = frame_seq++ ;
+    putFrameUint16(record, 2, frame_tag)    ;
+    for(k = 0 ; k < size ; k++)
+        record[k + 4] = payload[k]  ;
+    crc = crc16(record, size + 4, 0xFFFF)   ;
+    putFrameUint16(record, size + 4, crc)   ;
+
+    length = encodeCobs(record, size + 6, encoded)  ;
+    for(k = 0 ; k < length ; k++)
+        putcUart0(encoded[k])   ;
+    putcUart0(0)    ;
+}
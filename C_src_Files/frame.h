@@ -0,0 +1,45 @@
+// Binary Frame Library
+// Mourya
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef FRAME_H_
+#define FRAME_H_
+
+#include <stdint.h>
+
+// Record: type, sequence, command tag, payload, CRC16 (little endian), COBS encoded and ended by a 0 byte
+#define FRAME_VERSION       2
+#define FRAME_MAX_PAYLOAD   32
+
+// Record types
+#define FRAME_MODE          1       // version, sent when binary mode starts
+#define FRAME_STATUS        2       // status code
+#define FRAME_RAW           3       // tube, red, green, blue (uint16)
+#define FRAME_PH            4       // tube, pH x 1000 (uint16)
+#define FRAME_CALIBRATION   5       // color, pwm, analog (uint16)
+#define FRAME_SAMPLE        6       // streamed sample
+#define FRAME_DONE          7       // the tagged command has finished
+#define FRAME_PROGRESS      8       // measurement state, tube, color, level, limit, red, green, blue (uint16)
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+uint16_t crc16(const uint8_t *data, uint16_t size, uint16_t crc)            ;
+uint16_t encodeCobs(const uint8_t *in, uint16_t size, uint8_t *out)         ;
+uint8_t putFrameUint16(uint8_t *payload, uint8_t index, uint16_t value)     ;
+void setFrameTag(uint16_t tag)                                              ;
+void sendFrame(uint8_t type, const uint8_t *payload, uint8_t size)          ;
+
+#endif
@@ -0,0 +1,193 @@
+// IR Receiver Library
+// Mourya
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+// Hardware configuration:
+// IR receiver output (active low NEC frames) on PD0 / WT2CCP0
+// Wide Timer 2A counts up at 40 MHz and latches the time of each falling edge
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "tm4c123gh6pm.h"
+#include "ir.h"
+#include "scheduler.h"
+#include "nvic.h"
+#include "clock.h"
+
+// PortD masks
+#define IR_DATA_IN_MASK     1
+
+// Edge ring, size must be a power of 2
+#define IR_RING_SIZE        64
+
+// NEC timing in us, measured between falling edges
+#define IR_LEAD_MIN         13000       // 9 ms burst + 4.5 ms space
+#define IR_LEAD_MAX         14000
+#define IR_REPEAT_MIN       10750       // 9 ms burst + 2.25 ms space
+#define IR_REPEAT_MAX       11750
+#define IR_HOLD_MAX         120000      // 120 ms from the end of the last frame to a repeat leader
+#define IR_ZERO_MIN         844         // 1.125 ms
+#define IR_ZERO_MAX         1406
+#define IR_ONE_MIN          1969        // 2.25 ms
+#define IR_ONE_MAX          2531
+
+//-----------------------------------------------------------------------------
+// Global variables
+//-----------------------------------------------------------------------------
+
+// Single-producer (wideTimer2Isr) / single-consumer (decodeIr) edge ring
+uint32_t            ir_edges[IR_RING_SIZE]  ;
+volatile uint8_t    ir_head         = 0     ;   // written by wideTimer2Isr only
+volatile uint8_t    ir_tail         = 0     ;   // written by decodeIr only
+volatile bool       ir_overflow     = false ;
+
+// Decoder state
+uint8_t  ir_count   = 0 ;   // edges accepted in the present frame
+uint32_t ir_last    = 0 ;   // timestamp of the previous edge
+uint32_t ir_data    = 0 ;   // address, ~address, data, ~data (LSB first)
+uint32_t ir_ticks_per_us = 40 ;   // edge timestamps are in system clocks
+uint32_t ir_lead    = 0 ;   // timestamp of the present leader edge
+uint32_t ir_end     = 0 ;   // timestamp of the last edge of the last frame or repeat
+bool     ir_held    = false ;   // a valid frame may be followed by repeats
+uint8_t  ir_code    = 0 ;   // data byte of the last valid frame
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// Initialize Wide Timer 2A to capture the time of each falling edge on PD0
+void initIr()
+{
+    // Enable clocks
+    SYSCTL_RCGCWTIMER_R |= SYSCTL_RCGCWTIMER_R2;
+    SYSCTL_RCGCGPIO_R |= SYSCTL_RCGCGPIO_R3;
+    _delay_cycles(3);
+    ir_ticks_per_us = getSystemClockHz() / 1000000;
+
+    // Configure SIGNAL_IN for time measurements
+    GPIO_PORTD_AFSEL_R  |= IR_DATA_IN_MASK                                      ;// select alternative functions for SIGNAL_IN pin
+    GPIO_PORTD_PCTL_R   &= ~GPIO_PCTL_PD0_M                                     ;// map alt fns to SIGNAL_IN
+    GPIO_PORTD_PCTL_R   |= GPIO_PCTL_PD0_WT2CCP0                                ;//writing encoding value in port control register
+    GPIO_PORTD_DEN_R    |= IR_DATA_IN_MASK                                      ;// enable bit 1 for digital input
+
+    // Configure Wide Timer 2A for edge time capture
+    WTIMER2_CTL_R   &= ~TIMER_CTL_TAEN                                              ;// turn-off counter before reconfiguring
+    WTIMER2_CFG_R   = 4                                                             ;// configure as 32-bit counter (A only)
+    WTIMER2_TAMR_R  = TIMER_TAMR_TAMR_CAP | TIMER_TAMR_TACDIR |TIMER_TAMR_TACMR     ;// configure for edge time mode, count up
+    WTIMER2_CTL_R   = TIMER_CTL_TAEVENT_NEG                                         ;// capture on falling edges
+    WTIMER2_TAILR_R = 0xFFFFFFFF                                                    ;// free-run over the full 32-bit range
+    WTIMER2_ICR_R   = TIMER_ICR_CAECINT                                             ;// clear any stale capture
+    WTIMER2_IMR_R   = TIMER_IMR_CAEIM                                               ;// turn-on capture event interrupt
+    setNvicPriority(INT_WTIMER2A, PRIORITY_CAPTURE)                                 ;// edge times are read at once
+    NVIC_EN3_R      |= 1 << (INT_WTIMER2A-16-96)                                    ;// turn-on interrupt 114 (WTIMER2A)
+    WTIMER2_CTL_R   |= TIMER_CTL_TAEN                                               ;// turn-on counter
+}
+
+//Wide Timer 2A ISR, only queues the edge time latched by the capture hardware
+void wideTimer2Isr(void)
+{
+    uint32_t edge = WTIMER2_TAR_R                           ;
+    uint8_t  next = (ir_head + 1) & (IR_RING_SIZE - 1)     ;
+
+    if (next != ir_tail)
+    {
+        ir_edges[ir_head] = edge    ;
+        ir_head = next              ;
+    }
+    else
+        ir_overflow = true          ;
+    setEvent(EVENT_IR_EDGE)         ;
+
+    WTIMER2_ICR_R = TIMER_ICR_CAECINT;              // clear interrupt flag
+}
+
+// Decodes queued edges, returns IR_CODE with the data byte once a full frame has arrived
+uint8_t decodeIr(uint8_t *code)
+{
+    uint32_t edge , time_diff   ;
+    uint8_t  result = IR_NONE   ;
+
+    // edges were lost, restart at the next leader
+    if (ir_overflow)
+    {
+        ir_overflow = false ;
+        ir_count    = 0     ;
+    }
+
+    while (ir_tail != ir_head && result == IR_NONE)
+    {
+        edge        = ir_edges[ir_tail]                     ;
+        ir_tail     = (ir_tail + 1) & (IR_RING_SIZE - 1)    ;
+        time_diff   = (edge - ir_last) / ir_ticks_per_us    ;
+        ir_last     = edge                                  ;
+
+        if (ir_count == 0)
+        {
+            ir_lead  = edge ;
+            ir_count = 1    ;
+        }
+        else if (ir_count == 1)
+        {
+            //check whether this edge is the valid start edge of the IR command, otherwise it may be a new leader
+            if (time_diff >= IR_LEAD_MIN && time_diff <= IR_LEAD_MAX)
+            {
+                ir_data  = 0    ;
+                ir_count = 2    ;
+            }
+            //repeat burst, only valid while the key of the last frame is held
+            else if (time_diff >= IR_REPEAT_MIN && time_diff <= IR_REPEAT_MAX)
+            {
+                ir_count = 0    ;
+                if (ir_held && (ir_lead - ir_end) / ir_ticks_per_us <= IR_HOLD_MAX)
+                {
+                    ir_end  = edge          ;
+                    *code   = ir_code       ;
+                    result  = IR_REPEAT     ;
+                }
+                else
+                    ir_held = false ;
+            }
+            else
+                ir_lead = edge  ;
+        }
+        else
+        {
+            //checking whether these bits are valid IR Addr and Data
+            if (time_diff >= IR_ONE_MIN && time_diff <= IR_ONE_MAX)
+                ir_data |= (uint32_t)1 << (ir_count - 2)    ;
+            else if (!(time_diff >= IR_ZERO_MIN && time_diff <= IR_ZERO_MAX))
+            {
+                ir_lead  = edge ;
+                ir_count = 1    ;
+                continue        ;
+            }
+
+            if (++ir_count == 34)
+            {
+                ir_count = 0    ;
+                ir_end   = edge ;
+                ir_held  = (uint8_t)ir_data == (uint8_t)~(ir_data >> 8) && (uint8_t)(ir_data >> 16) == (uint8_t)~(ir_data >> 24) ;
+                if (ir_held)
+                {
+                    ir_code = ir_data >> 16 ;
+                    *code   = ir_code       ;
+                    result  = IR_CODE       ;
+                }
+                else
+                    result  = IR_ERROR      ;
+            }
+        }
+    }
+    return result   ;
+}
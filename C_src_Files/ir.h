@@ -0,0 +1,37 @@
+// IR Receiver Library
+// Mourya
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+// Hardware configuration:
+// IR receiver output (active low NEC frames) on PD0 / WT2CCP0
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef IR_H_
+#define IR_H_
+
+#include <stdint.h>
+
+// decodeIr() results
+#define IR_NONE         0       // no complete frame yet
+#define IR_CODE         1       // valid frame, code holds the data byte
+#define IR_ERROR        2       // frame failed the address/data inverse check
+#define IR_REPEAT       3       // repeat frame of a held key, code holds the last data byte
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void initIr()                   ;
+uint8_t decodeIr(uint8_t *code) ;
+
+#endif
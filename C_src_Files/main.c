@@ -21,8 +21,8 @@
 //-----------------------------------------------------------------------------
 
 #include <stdint.h>
-#include <stdio.h>
 #include <stdbool.h>
+#include <stdlib.h>
 #include <string.h>
 #include "clock.h"
 #include "tm4c123gh6pm.h"
@@ -31,16 +31,19 @@
 #include "Stepper_motor.h"
 #include "adc0.h"
 #include "rgb_led.h"
+#include "udma.h"
+#include "ir.h"
+#include "cancel.h"
+#include "format.h"
+#include "frame.h"
+#include "tick.h"
+#include "scheduler.h"
+#include "coroutine.h"
+#include "nvic.h"
 
 // PortB masks
 #define AIN11_MASK 32
 
-//PORT D bit band definition
-#define PD0_IR_DATA  (*((volatile uint32_t *)(0x42000000 + (0x400073FC-0x40000000)*32 + 0*4)))
-
-// PortD masks
-#define IR_DATA_IN_MASK 1
-
 // port F Bitband aliases
 #define RED_LED      (*((volatile uint32_t *)(0x42000000 + (0x400253FC-0x40000000)*32 + 1*4)))
 #define GREEN_LED    (*((volatile uint32_t *)(0x42000000 + (0x400253FC-0x40000000)*32 + 3*4)))
@@ -51,21 +54,86 @@
 #define GREEN_LED_MASK              8
 #define PUSH_BUTTON_MASK            16
 
+// Actions shared by the UART commands and the IR keymap
+#define ACTION_NONE                 0
+#define ACTION_TUBE                 1
+#define ACTION_MEASURE              2
+#define ACTION_MEASURE_PH           3
+#define ACTION_HOME                 4
+#define ACTION_CALIBRATE            5
+#define ACTION_JOG_CW               6
+#define ACTION_JOG_CCW              7
+#define ACTION_CANCEL               8
+#define ACTION_COUNT                9
+
+#define NO_TUBE                     0xFF
+
+// Hold-to-jog, the step count per repeat frame (108 ms) doubles every JOG_RAMP_REPEATS frames
+#define JOG_RAMP_REPEATS            4
+#define JOG_MAX_STEPS               4       // moves of 4 steps still finish within one repeat period
+
+// Baud rate changes
+#define BAUD_MIN                    9600
+#define BAUD_MAX                    2500000 // system clock / 16
+#define BAUD_CONFIRM_MS             2000    // time for the host to send ok at the new rate
+#define AUTOBAUD_TIMEOUT_MS         10000
+#define AUTOBAUD_RETRY_MS           500     // after framing errors, the host repeats 'U' with pauses until it is answered
+#define AUTOBAUD_FRAMING_ERRORS     4       // framing errors within the window that arm autobaud, fewer are line noise
+#define AUTOBAUD_FRAMING_WINDOW_MS  1000
+
+// Status reports, indexes status_text[]
+#define STATUS_IR_FAIL              0
+#define STATUS_INVALID_TUBE         1
+#define STATUS_INVALID_KEY          2
+#define STATUS_BUSY                 3
+#define STATUS_CANCELLED            4
+#define STATUS_INVALID_COMMAND      5
+#define STATUS_INVALID_ARGS         6
+#define STATUS_QUEUE_FULL           7
+
+// Tagged commands ("#<id> <command>") wait in a queue, size must be a power of 2
+#define QUEUE_SIZE                  8
+
+// Calibration colors
+#define COLOR_RED                   0
+#define COLOR_GREEN                 1
+#define COLOR_BLUE                  2
+
+// Streaming acquisition, each sample reads the three LEDs at their setpoints
+#define LED_SETTLE_US               10000   // LED on to reading
+#define STREAM_MAX_RATE             30      // samples/s, three settles fill the period
+#define STREAM_POLL_US              1000
+#define PH_MAX                      14
+#define PH_MAX_THOUSANDTHS          (PH_MAX * 1000)
+#define DEADBAND_MAX_COUNTS         4095    // full scale of the 12 bit ADC
+#define DEADBAND_MAX_HEARTBEAT_MS   3600000
+
+// Response curve output, two blocks alternate between filling and uDMA transmit
+#define CURVE_BLOCK_SIZE            512
+#define CURVE_LINE_MAX              24      // "#65535 r,1023,4095\n" with margin
+
+// Step-rate characterization
+#define CHAR_PERIOD_STEP_US         500     // period decrement per run (runSteppers() tick)
+#define CHAR_MIN_PERIOD_US          1500
+#define CHAR_ROUND_TRIPS            3       // lost steps accumulate over the trips of one run
+#define CHAR_TOLERANCE              64      // ADC counts allowed between reference readings
+
+// Measurement steps, indexes measure_state_name[]
+#define MEASURE_IDLE                0
+#define MEASURE_MOVE                1       // carousel moving to the tube
+#define MEASURE_SETTLE              2       // LEDs off before the next color
+#define MEASURE_RAMP                3       // LED on at the present level until it is read
+#define MEASURE_SETTLE_US           10000
+#define MEASURE_RAMP_US             1000
+
+// Calibration sweep
+#define CALIBRATE_TARGET            3072    // 3/4 of the ADC range
+#define CALIBRATE_MAX_LEVEL         1024
+#define CALIBRATE_STEP_US           30000
+
 //-----------------------------------------------------------------------------
 // Global variables
 //-----------------------------------------------------------------------------
-//IR sensor
-
-bool     valid      = false ;
-uint32_t time_diff  = 0 ,ADDR_DATA_REG=0    ;
-uint32_t time[50]   = {0}   ;
-uint8_t  count      = 0     ;
-uint8_t  code       = 0     ;
-uint8_t  ADDR       = 0     ;
-uint8_t  NEG_ADDR   = 0     ;
-uint8_t  DATA       = 0     ;
-uint8_t  NEG_DATA   = 0     ;
-
 //Ambient sensor
 uint8_t Tube_value      =   0   ;
 uint16_t ii             =   0   ;
@@ -79,7 +147,6 @@ uint16_t analog_b       =   0   ;
 float analog_r_ref   =   0   ;
 float analog_g_ref   =   0   ;
 float analog_b_ref   =   0   ;
-char str[100];
 
 uint16_t RAW_R[5]={3149,2737,2997,2905,2846}    ;
 uint16_t RAW_G[5]={2663,1163,763,232,1082}      ;
@@ -89,124 +156,582 @@ float d_sqr[5]    =   {0}                       ;
 float pH_HC[5]    =   {6.8,7.5,7.8,8.7,7.2}     ;
 float fin_pH      = 0                           ;
 
+//Result reporting, text for interactive use or COBS framed records once the host selects binary mode
+bool binary_mode  = false ;
+
+//Framing errors counted towards autobaud, the count restarts once the window has passed
+uint8_t  framing_errors     = 0 ;
+uint32_t framing_start_ms   = 0 ;
+
+char *status_text[] =
+{
+    "\n Fail \n",
+    "\n invalid Tube Selection ",
+    "\n invalid key action ",
+    "\n busy \n",
+    "\n cancelled \n",
+    "\n invalid command ",
+    "\n invalid arguments ",
+    "\n queue full ",
+};
+
+char *color_name[] = {"red", "green", "blue"};
+
+//Actions, indexed by ACTION_xxx, the name is also the UART command
+typedef struct _ACTION
+{
+    const char  *name                   ;
+    bool        tubeArg                 ;   // takes a tube (R or 0-5) argument
+    void        (*handler)(uint8_t arg) ;
+} ACTION;
+
+void measureAction(uint8_t tube)    ;
+void measurePhAction(uint8_t tube)  ;
+void homeAction(uint8_t arg)        ;
+void calibrateAction(uint8_t arg)   ;
+void jogCw(uint8_t repeats)         ;
+void jogCcw(uint8_t repeats)        ;
+void cancelAction(uint8_t arg)      ;
+
+const ACTION actions[ACTION_COUNT] =
+{
+    {"none",        false,  0               },
+    {"tube",        true,   goto_tube       },
+    {"measure",     true,   measureAction   },
+    {"measurepH",   true,   measurePhAction },
+    {"home",        false,  homeAction      },
+    {"calibrate",   false,  calibrateAction },
+    {"jogcw",       false,  jogCw           },
+    {"jogccw",      false,  jogCcw          },
+    {"cancel",      false,  cancelAction    },
+};
+
+//IR keymap, indexed by the NEC data byte
+typedef struct _IR_KEY
+{
+    uint8_t action  ;
+    uint8_t arg     ;
+} IR_KEY;
+
+IR_KEY ir_keymap[256]   ;
+uint8_t ir_repeats      = 0 ;   // repeat frames since the held key was pressed
+
+//Report-by-exception for streamed samples, a zero band reports every change and a zero heartbeat never forces a report
+typedef struct _DEADBAND
+{
+    uint16_t counts         ;   // R/G/B change in ADC counts
+    uint16_t pH             ;   // pH change in thousandths
+    uint32_t heartbeatMs    ;   // longest time between reports
+} DEADBAND;
+
+typedef struct _SAMPLE
+{
+    uint32_t time   ;   // ms
+    uint16_t r      ;
+    uint16_t g      ;
+    uint16_t b      ;
+    uint16_t pH     ;   // thousandths
+} SAMPLE;
+
+DEADBAND deadband       = {0, 0, 0} ;
+SAMPLE   last_report                ;
+uint16_t suppressed     = 0         ;   // samples not reported since the last report
+
+//Measurement of one tube, stepMeasurement() is its coroutine
+typedef struct _MEASUREMENT
+{
+    COROUTINE co        ;
+    uint8_t  state      ;   // MEASURE_xxx
+    uint8_t  tube       ;
+    uint8_t  color      ;   // COLOR_xxx being ramped
+    bool     pH         ;   // report the pH rather than the readings
+    uint16_t level      ;   // LED level of the present color
+    uint16_t reading[3] ;   // by COLOR_xxx, final for the colors already ramped
+    uint32_t last       ;   // getMicros() when the carousel was last serviced
+} MEASUREMENT;
+
+MEASUREMENT measurement = {{0}, MEASURE_IDLE}   ;
+char *measure_state_name[] = {"idle", "move", "settle", "ramp"};
+
+//LED calibration, stepCalibration() is its coroutine
+typedef struct _CALIBRATION
+{
+    COROUTINE co        ;
+    uint8_t  color      ;   // COLOR_xxx being swept
+    uint16_t level      ;
+    uint16_t reading    ;
+    uint16_t old[3]     ;   // setpoints restored if the sweep is cancelled
+} CALIBRATION;
+
+CALIBRATION calibration ;
+
+//Operation running in the background, its step function returns false once it has ended
+bool     (*operation)(void) = 0 ;
+COROUTINE *operation_co     = 0 ;   // coroutine of the operation, its delays let the scheduler sleep
+uint16_t operation_tag      = 0 ;   // queued command waiting on the operation, 0 if untagged
+
+//Response curve blocks, busy from sendUart0Block() until the block has been read
+char curve_blocks[2][CURVE_BLOCK_SIZE]  ;
+volatile bool curve_busy[2]             ;
+
+//Command lines, tokenized by pollsUart0() as they arrive
+USER_DATA command_data  ;
+USER_DATA busy_data     ;   // collected while an operation is running
+
+//Tagged commands run in order, results carry the tag of the running command (0 if untagged)
+typedef struct _QUEUED_COMMAND
+{
+    uint16_t    tag     ;
+    USER_DATA   data    ;
+} QUEUED_COMMAND;
+
+QUEUED_COMMAND command_queue[QUEUE_SIZE]    ;
+uint8_t  queue_head     = 0 ;
+uint8_t  queue_tail     = 0 ;
+uint16_t command_tag    = 0 ;
+char     result_label   = 0 ;   // tube label after the tag of batch text results, 0 for none
+
+//Default keys of the 44-key remote
+const struct
+{
+    uint8_t code    ;
+    uint8_t action  ;
+    uint8_t arg     ;
+} default_keys[] =
+{
+    {0x58, ACTION_TUBE, 0}, {0x54, ACTION_TUBE, 1}, {0x50, ACTION_TUBE, 2},
+    {0x1C, ACTION_TUBE, 3}, {0x18, ACTION_TUBE, 4}, {0x14, ACTION_TUBE, 5},
+    {0x59, ACTION_MEASURE, 0}, {0x55, ACTION_MEASURE, 1}, {0x51, ACTION_MEASURE, 2},
+    {0x1D, ACTION_MEASURE, 3}, {0x19, ACTION_MEASURE, 4}, {0x15, ACTION_MEASURE, 5},
+    {0x45, ACTION_MEASURE_PH, 0}, {0x49, ACTION_MEASURE_PH, 1}, {0x4D, ACTION_MEASURE_PH, 2},
+    {0x1E, ACTION_MEASURE_PH, 3}, {0x1A, ACTION_MEASURE_PH, 4}, {0x16, ACTION_MEASURE_PH, 5},
+    {0x5C, ACTION_HOME, 0},         //Brightup
+    {0x5D, ACTION_CALIBRATE, 0},    //Bright down
+    {0x17, ACTION_JOG_CW, 0},       //Quick
+    {0x13, ACTION_JOG_CCW, 0},      //Slow
+    {0x40, ACTION_CANCEL, 0},       //Off
+};
+
 //-----------------------------------------------------------------------------
 // Subroutines
 //-----------------------------------------------------------------------------
 
-void enableWideTimer()
+//setCommandTag() sets the tag of the following results
+void setCommandTag(uint16_t tag)
 {
-    // Configure Wide Timer 2 as counter of external events on CCP0 pin
-    WTIMER2_CTL_R   &= ~TIMER_CTL_TAEN                                              ;// turn-off counter before reconfiguring
-    WTIMER2_CFG_R   = 4                                                             ;// configure as 32-bit counter (A only)
-    WTIMER2_TAMR_R  = TIMER_TAMR_TAMR_CAP | TIMER_TAMR_TACDIR |TIMER_TAMR_TACMR     ;// configure for edge time mode, count up
-    WTIMER2_CTL_R   = 0                                                             ;// Disable the timer
-    WTIMER2_IMR_R   = 0                                                             ;// turn-off interrupts
-    WTIMER2_TAV_R   = 0                                                             ;// zero counter for first period
-    WTIMER2_CTL_R   |= TIMER_CTL_TAEN                                               ;// turn-on counter
+    command_tag = tag;
+    setFrameTag(tag);
+}
 
+//putTag() starts a text result of a tagged command with "#<id> ", then the tube label inside a batch
+void putTag(void)
+{
+    if (command_tag != 0)
+    {
+        putsUart0("#");
+        putUintUart0(command_tag, 0);
+        putsUart0(" ");
+    }
+    if (result_label != 0)
+    {
+        putcUart0(result_label);
+        putsUart0(": ");
+    }
 }
 
-void calibrate(void)
+//putResult() writes a tagged, labelled value and a new line
+void putResult(char *label, uint32_t value, uint8_t width)
+{
+    putTag();
+    putsUart0(label);
+    putUintUart0(value, width);
+    putsUart0("\n");
+}
+
+//formatTag() writes the "#<id> " of a tagged command into a block, returns its length
+uint8_t formatTag(char *out)
 {
+    uint8_t length = 0 ;
+    if (command_tag == 0)
+        return 0;
+    out[length++] = '#';
+    length += formatUint(&out[length], command_tag, 0);
+    out[length++] = ' ';
+    return length;
+}
+
+//reportStatus() reports a STATUS_xxx event
+void reportStatus(uint8_t status)
+{
+    if (binary_mode)
+        sendFrame(FRAME_STATUS, &status, 1);
+    else
+    {
+        putTag();
+        putsUart0(status_text[status]);
+    }
+}
+
+//reportTaggedStatus() reports a STATUS_xxx event for a command other than the running one
+void reportTaggedStatus(uint16_t tag, uint8_t status)
+{
+    uint16_t running = command_tag ;
+    setCommandTag(tag);
+    reportStatus(status);
+    setCommandTag(running);
+}
+
+//reportDone() marks the end of the results of a tagged command
+void reportDone(void)
+{
+    if (command_tag == 0)
+        return;
+    if (binary_mode)
+        sendFrame(FRAME_DONE, 0, 0);
+    else
+    {
+        putTag();
+        putsUart0("done\n");
+    }
+}
 
-    pwm_r      =   0   ;
-    pwm_g      =   0   ;
-    pwm_b      =   0   ;
-    //RED TEST
-    raw = 0;
-    for (ii = 0; raw < 3072 && ii < 1024; ii++) {
-        setRgbColor(ii, 0, 0);
-        waitMicrosecond(30000);
-        raw = readAdc0Ss3();
-    }
-     pwm_r = ii;
-     analog_r = raw;
-    sprintf(str, "red_pwm:          %4u\n", pwm_r);
-    putsUart0(str);
-    sprintf(str, "red_analog:          %4u\n", analog_r);
-    putsUart0(str);
-    raw = 0;
-
-    //GREEN TEST
-    for (ii = 0; raw < 3072 && ii < 1024; ii++) {
-        setRgbColor(0, ii, 0);
-        waitMicrosecond(30000);
-        raw = readAdc0Ss3();
-    }
-     pwm_g = ii;
-     analog_g = raw;
-
-    sprintf(str, "green_pwm:          %4u\n", pwm_g);
-    putsUart0(str);
-    sprintf(str, "green_analog:          %4u\n", analog_g);
-    putsUart0(str);
-    raw = 0;
-
-    //BLUE TEST
-    for (ii = 0; raw < 3072 && ii < 1024; ii++) {
-        setRgbColor(0, 0, ii);
-        waitMicrosecond(30000);
-        raw = readAdc0Ss3();
-    }
-     pwm_b = ii;
-     analog_b = raw;
-
-    sprintf(str, "blue_pwm:          %4u\n", pwm_b);
-    putsUart0(str);
-    sprintf(str, "blue_analog:          %4u\n", analog_b);
-    putsUart0(str);
+//reportCalibration() reports the setpoint found for one color
+void reportCalibration(uint8_t color, uint16_t pwm, uint16_t analog)
+{
+    uint8_t payload[5] ;
+    if (binary_mode)
+    {
+        payload[0] = color;
+        sendFrame(FRAME_CALIBRATION, payload, putFrameUint16(payload, putFrameUint16(payload, 1, pwm), analog));
+        return;
+    }
+    putTag();
+    putsUart0(color_name[color]);
+    putsUart0("_pwm:          ");
+    putUintUart0(pwm, 4);
+    putsUart0("\n");
+    putTag();
+    putsUart0(color_name[color]);
+    putsUart0("_analog:          ");
+    putUintUart0(analog, 4);
+    putsUart0("\n");
+}
+
+//reportRaw() reports the readings of a tube
+void reportRaw(uint8_t tube, uint16_t r, uint16_t g, uint16_t b)
+{
+    uint8_t payload[7] ;
+    if (binary_mode)
+    {
+        payload[0] = tube;
+        sendFrame(FRAME_RAW, payload, putFrameUint16(payload, putFrameUint16(payload, putFrameUint16(payload, 1, r), g), b));
+        return;
+    }
+    putTag();
+    putsUart0("(");
+    putUintUart0(r, 4);
+    putsUart0(",");
+    putUintUart0(g, 4);
+    putsUart0(",");
+    putUintUart0(b, 4);
+    putsUart0(")\n");
+}
+
+//reportSample() reports one streamed sample with the count of samples suppressed before it
+void reportSample(SAMPLE *sample, uint16_t skipped)
+{
+    uint8_t payload[14] ;
+    if (binary_mode)
+    {
+        putFrameUint16(payload, putFrameUint16(payload, 0, sample->time & 0xFFFF), sample->time >> 16);
+        putFrameUint16(payload, putFrameUint16(payload, putFrameUint16(payload, 4, sample->r), sample->g), sample->b);
+        sendFrame(FRAME_SAMPLE, payload, putFrameUint16(payload, putFrameUint16(payload, 10, sample->pH), skipped));
+        return;
+    }
+    putTag();
+    putUintUart0(sample->time, 0);
+    putsUart0(",");
+    putUintUart0(sample->r, 0);
+    putsUart0(",");
+    putUintUart0(sample->g, 0);
+    putsUart0(",");
+    putUintUart0(sample->b, 0);
+    putsUart0(",");
+    putFixedUart0(sample->pH, 3, 0);
+    putsUart0(",");
+    putUintUart0(skipped, 0);
+    putsUart0("\n");
+}
+
+//outsideBand() returns true if value has moved more than band from last, any change with a zero band
+bool outsideBand(uint16_t value, uint16_t last, uint16_t band)
+{
+    uint16_t change = value > last ? value - last : last - value ;
+    return band == 0 ? change > 0 : change > band;
+}
+
+//reportException() reports a sample only if it left the deadband around the last report or the heartbeat expired
+void reportException(SAMPLE *sample, bool first)
+{
+    if (first
+        || outsideBand(sample->r, last_report.r, deadband.counts)
+        || outsideBand(sample->g, last_report.g, deadband.counts)
+        || outsideBand(sample->b, last_report.b, deadband.counts)
+        || outsideBand(sample->pH, last_report.pH, deadband.pH)
+        || (deadband.heartbeatMs > 0 && sample->time - last_report.time >= deadband.heartbeatMs))
+    {
+        reportSample(sample, first ? 0 : suppressed);
+        last_report = *sample;
+        suppressed  = 0;
+    }
+    else if (suppressed < 0xFFFF)
+        suppressed++;
+}
+
+//scalePh() rounds a pH to a whole number of 1/scale units, clamped to pH 0 to PH_MAX
+//NaN (no distinct nearest references) fails both compares and gives 0
+uint32_t scalePh(float pH, uint32_t scale)
+{
+    float scaled = pH * scale ;
+
+    if (scaled > (float)PH_MAX * scale)
+        return PH_MAX * scale;
+    if (scaled > 0)
+        return scaled + 0.5f;
+    return 0;
+}
+
+//reportPh() reports the pH of a tube, in thousandths in binary mode
+void reportPh(uint8_t tube, float pH)
+{
+    uint8_t payload[3] ;
+    if (binary_mode)
+    {
+        payload[0] = tube;
+        sendFrame(FRAME_PH, payload, putFrameUint16(payload, 1, scalePh(pH, 1000)));
+        return;
+    }
+    putTag();
+    putsUart0("pH:          ");
+    putFixedUart0(scalePh(pH, 1000000), 6, 4);
+    putsUart0("\n");
+}
+
+//colorLimit() returns the calibrated setpoint of a color
+uint16_t colorLimit(uint8_t color)
+{
+    if (color == COLOR_RED)
+        return pwm_r;
+    if (color == COLOR_GREEN)
+        return pwm_g;
+    return pwm_b;
+}
+
+//setColor() lights one LED at a level with the others off
+void setColor(uint8_t color, uint16_t level)
+{
+    setRgbColor(color == COLOR_RED ? level : 0, color == COLOR_GREEN ? level : 0, color == COLOR_BLUE ? level : 0);
+}
+
+//reportProgress() reports the step, tube, color and LED level of a measurement with the readings so far
+void reportProgress(MEASUREMENT *m)
+{
+    uint8_t payload[13] , size ;
+    if (binary_mode)
+    {
+        payload[0] = m->state;
+        payload[1] = m->tube;
+        payload[2] = m->color;
+        size = putFrameUint16(payload, putFrameUint16(payload, 3, m->level), colorLimit(m->color));
+        size = putFrameUint16(payload, putFrameUint16(payload, putFrameUint16(payload, size, m->reading[COLOR_RED]), m->reading[COLOR_GREEN]), m->reading[COLOR_BLUE]);
+        sendFrame(FRAME_PROGRESS, payload, size);
+        return;
+    }
+    putTag();
+    putsUart0("progress: ");
+    putsUart0(measure_state_name[m->state]);
+    if (m->state != MEASURE_IDLE)
+    {
+        putsUart0(" tube ");
+        putUintUart0(m->tube, 0);
+        putsUart0(" ");
+        putsUart0(color_name[m->color]);
+        putsUart0(" ");
+        putUintUart0(m->level, 0);
+        putsUart0("/");
+        putUintUart0(colorLimit(m->color), 0);
+        putsUart0(" (");
+        putUintUart0(m->reading[COLOR_RED], 0);
+        putsUart0(",");
+        putUintUart0(m->reading[COLOR_GREEN], 0);
+        putsUart0(",");
+        putUintUart0(m->reading[COLOR_BLUE], 0);
+        putsUart0(")");
+    }
+    putsUart0("\n");
+}
+
+//restoreCalibration() turns the LEDs off and keeps the previous setpoints after a cancelled sweep
+void restoreCalibration(uint16_t r, uint16_t g, uint16_t b)
+{
+    setRgbColor(0, 0, 0);
+    pwm_r = r;
+    pwm_g = g;
+    pwm_b = b;
+}
+
+//storeCalibration() keeps the setpoint found for one color and the reading it gave
+void storeCalibration(uint8_t color, uint16_t pwm, uint16_t analog)
+{
+    if (color == COLOR_RED)
+    {
+        pwm_r    = pwm;
+        analog_r = analog;
+    }
+    else if (color == COLOR_GREEN)
+    {
+        pwm_g    = pwm;
+        analog_g = analog;
+    }
+    else
+    {
+        pwm_b    = pwm;
+        analog_b = analog;
+    }
+}
+
+//startCalibration() prepares a sweep of each LED, stepCalibration() runs it
+void startCalibration(CALIBRATION *c)
+{
+    CO_INIT(&c->co);
+    c->old[COLOR_RED]   = pwm_r;
+    c->old[COLOR_GREEN] = pwm_g;
+    c->old[COLOR_BLUE]  = pwm_b;
+    pwm_r = 0;
+    pwm_g = 0;
+    pwm_b = 0;
+}
+
+//stepCalibration() sweeps each LED until the sensor reaches 3/4 scale, the previous calibration is kept if it is cancelled
+//Coroutine, returns true while the sweep is running
+bool stepCalibration(CALIBRATION *c)
+{
+    CO_BEGIN(&c->co);
+    for (c->color = COLOR_RED; c->color <= COLOR_BLUE; c->color++)
+    {
+        c->reading = 0;
+        for (c->level = 0; c->reading < CALIBRATE_TARGET && c->level < CALIBRATE_MAX_LEVEL && !isCancelRequested(); c->level++)
+        {
+            setColor(c->color, c->level);
+            CO_DELAY_US(&c->co, CALIBRATE_STEP_US);
+            c->reading = readAdc0Ss3();
+        }
+        if (isCancelRequested())
+        {
+            restoreCalibration(c->old[COLOR_RED], c->old[COLOR_GREEN], c->old[COLOR_BLUE]);
+            CO_EXIT(&c->co);
+        }
+        storeCalibration(c->color, c->level, c->reading);
+        reportCalibration(c->color, c->level, c->reading);
+    }
 
     analog_r_ref = analog_r;
     analog_g_ref = analog_g;
     analog_b_ref = analog_b;
-
-    raw = 0;
     setRgbColor(0, 0, 0);
+    CO_END(&c->co);
 }
 
-void measure(uint8_t tube,uint16_t *r,uint16_t *g,uint16_t *b)
+//calibrate() runs a calibration to its end
+void calibrate(void)
 {
-    goto_tube(tube);
-    setRgbColor(0, 0, 0);
-    waitMicrosecond(10000); //This wait is to make tube settled
-    //Set red LED
-    uint16_t i = 0;
-    for (i = 0; i <= pwm_r; i++) {
-        setRgbColor(i, 0, 0);
-        waitMicrosecond(1000);
-        *r=readAdc0Ss3();
+    startCalibration(&calibration);
+    while (stepCalibration(&calibration))
+    {
+        pollCancel();
+        waitMicrosecond(CO_WAIT_US(&calibration.co));
     }
+}
+
+//startMeasurement() starts the carousel towards a tube, stepMeasurement() then sweeps each LED up to its calibrated setpoint
+void startMeasurement(MEASUREMENT *m, uint8_t tube)
+{
+    CO_INIT(&m->co);
+    m->state    = MEASURE_MOVE;
+    m->tube     = tube;
+    m->color    = COLOR_RED;
+    m->level    = 0;
+    m->reading[COLOR_RED]   = 0;
+    m->reading[COLOR_GREEN] = 0;
+    m->reading[COLOR_BLUE]  = 0;
+    m->last     = getMicros();
     setRgbColor(0, 0, 0);
-    waitMicrosecond(10000);
-    //Set Green LED
-    for (i = 0; i <= pwm_g; i++) {
-        setRgbColor(0, i, 0);
-        waitMicrosecond(1000);
-        *g=readAdc0Ss3();
+    if (tube < carousel.tubeCount)
+        startStepperMove(&carousel, carousel.tubePosition[tube]);
+}
+
+//stepMeasurement() services the carousel until it reaches the tube, then ramps each LED reading the sensor at every level
+//Coroutine, returns true while the measurement is running
+//A cancel stops the carousel after its present step and turns the LEDs off, the readings are then partial
+bool stepMeasurement(MEASUREMENT *m)
+{
+    CO_BEGIN(&m->co);
+    while (serviceStepper(&carousel, getMicros() - m->last))
+    {
+        m->last = getMicros();
+        if (isCancelRequested())
+            stopStepper(&carousel);
+        CO_DELAY_US(&m->co, STEPPER_TICK_US);
     }
-    setRgbColor(0, 0, 0);
-    waitMicrosecond(10000);
-    //Set Green LED
-    for (i = 0; i <= pwm_b; i++) {
-        setRgbColor(0, 0, i);
-        waitMicrosecond(1000);
-        *b=readAdc0Ss3();
+
+    for (m->color = COLOR_RED; m->color <= COLOR_BLUE && !isCancelRequested(); m->color++)
+    {
+        m->state = MEASURE_SETTLE;
+        setRgbColor(0, 0, 0);
+        CO_DELAY_US(&m->co, MEASURE_SETTLE_US);
+
+        m->state = MEASURE_RAMP;
+        for (m->level = 0; m->level <= colorLimit(m->color) && !isCancelRequested(); m->level++)
+        {
+            setColor(m->color, m->level);
+            CO_DELAY_US(&m->co, MEASURE_RAMP_US);
+            m->reading[m->color] = readAdc0Ss3();
+        }
     }
+    m->color = COLOR_BLUE;
+    m->state = MEASURE_IDLE;
     setRgbColor(0, 0, 0);
+    CO_END(&m->co);
 }
 
-void measurepH(uint8_t tube)
+//measure() runs a measurement to its end, returns false if it is cancelled
+bool measure(uint8_t tube,uint16_t *r,uint16_t *g,uint16_t *b)
 {
-    float d_first_min = 0 , d_second_min = 0 ,temp = 0 ,diff_r = 0,diff_g = 0,diff_b = 0,diff_r_div = 0,diff_g_div = 0,diff_b_div = 0,diff_r_sqr = 0,diff_g_sqr = 0,diff_b_sqr = 0  ;
+    measurement.pH  = false;
+    startMeasurement(&measurement, tube);
+    while (stepMeasurement(&measurement))
+    {
+        pollCancel();
+        waitMicrosecond(CO_WAIT_US(&measurement.co));
+    }
+    *r = measurement.reading[COLOR_RED];
+    *g = measurement.reading[COLOR_GREEN];
+    *b = measurement.reading[COLOR_BLUE];
+    return !isCancelRequested();
+}
+
+//computePh() interpolates the pH between the two nearest reference readings
+float computePh(uint16_t r, uint16_t g, uint16_t b)
+{
+    float d_first_min = 0 , d_second_min = 0 ,diff_r = 0,diff_g = 0,diff_b = 0,diff_r_div = 0,diff_g_div = 0,diff_b_div = 0,diff_r_sqr = 0,diff_g_sqr = 0,diff_b_sqr = 0  ;
     uint8_t first_min_index = 0,second_min_index = 0    ;
-    measure(tube,&analog_r,&analog_g,&analog_b) ;
 
 
     for(ii=0;ii<5;ii++)
     {
-        diff_r = (float)(analog_r - RAW_R[ii])  ;
-        diff_g = (float)(analog_g - RAW_G[ii])  ;
-        diff_b = (float)(analog_b - RAW_B[ii])  ;
+        diff_r = (float)(r - RAW_R[ii])  ;
+        diff_g = (float)(g - RAW_G[ii])  ;
+        diff_b = (float)(b - RAW_B[ii])  ;
 
         diff_r_div = diff_r/3072    ;
         diff_g_div = diff_g/3072    ;
@@ -221,46 +746,243 @@ void measurepH(uint8_t tube)
         d_sqr[ii]   = diff_r_sqr + diff_g_sqr + diff_b_sqr  ;
     }
 
-    //Finding minimum
-    d_first_min = d_sqr[0];
+    //Finding the nearest and second nearest references, indexes stay within the 5 references
+    if(d_sqr[1] < d_sqr[0])
+    {
+        first_min_index     = 1 ;
+        second_min_index    = 0 ;
+    }
+    else
+    {
+        first_min_index     = 0 ;
+        second_min_index    = 1 ;
+    }
 
-     for ( ii = 1 ; ii < 5 ; ii++ )
+     for ( ii = 2 ; ii < 5 ; ii++ )
      {
-         if ( d_sqr[ii] < d_first_min )
+         if ( d_sqr[ii] < d_sqr[first_min_index] )
          {
-             d_first_min = d_sqr[ii];
-             first_min_index = ii+1;
+             second_min_index   = first_min_index   ;
+             first_min_index    = ii                ;
          }
+         else if ( d_sqr[ii] < d_sqr[second_min_index] )
+             second_min_index   = ii                ;
      }
+     d_first_min    = d_sqr[first_min_index]    ;
+     d_second_min   = d_sqr[second_min_index]   ;
 
-     //finding maximum
-     for ( ii = 0 ; ii < 5 ; ii++ )
-     {
-         if ( d_sqr[ii] > d_second_min )
-         {
-             d_second_min = d_sqr[ii];
-         }
-     }
+     //a reading on both references has no distance to weigh
+     if(d_first_min + d_second_min == 0)
+         return pH_HC[first_min_index]  ;
 
-     //finding second minimum
+     //pH formula
 
-     for(ii=0 ;ii <5 ;ii++)
-     {
-        temp = d_sqr[ii]    ;
-        if(temp > d_first_min && temp < d_second_min)
-        {
-            d_second_min = temp ;
-            second_min_index = ii   ;
-        }
-     }
+     return pH_HC[first_min_index] + ((pH_HC[second_min_index] - pH_HC[first_min_index])*(d_first_min/(d_first_min+d_second_min)))    ;
+}
 
-     //pH formula
+//reportMeasurement() reports the last readings, or the pH computed from them
+void reportMeasurement(uint8_t tube, bool pH)
+{
+    if (!pH)
+    {
+        reportRaw(tube, analog_r, analog_g, analog_b);
+        return;
+    }
+    fin_pH = computePh(analog_r, analog_g, analog_b);
+    reportPh(tube, fin_pH);
+}
 
-     fin_pH = pH_HC[first_min_index] + ((pH_HC[second_min_index] - pH_HC[first_min_index])*(d_first_min/(d_first_min+d_second_min)))    ;
+void measurepH(uint8_t tube)
+{
+    if (!measure(tube,&analog_r,&analog_g,&analog_b))
+        return;
+    reportMeasurement(tube, true);
+}
 
-     sprintf(str, "pH:          %4f\n", fin_pH);
-     putsUart0(str);
+//readLed() reads the sensor once the LED has settled at the given setting, then turns it off
+uint16_t readLed(uint16_t r, uint16_t g, uint16_t b)
+{
+    uint16_t value ;
+    setRgbColor(r, g, b);
+    waitMicrosecond(LED_SETTLE_US);
+    value = readAdc0Ss3();
+    setRgbColor(0, 0, 0);
+    return value;
+}
 
+//readReference() reads the red channel at the calibrated setpoint, used as a position check at the reference slot
+uint16_t readReference(void)
+{
+    return readLed(pwm_r, 0, 0);
+}
+
+//stream() parks on a tube and samples R/G/B at the calibrated setpoints rate times a second until cancelled or count samples (0 for no limit)
+//Samples are reported by exception against the deadband, timestamps are ms from the start of the stream
+void stream(uint8_t tube, uint8_t rate, uint32_t count)
+{
+    uint32_t index , start , due ;
+    SAMPLE   sample ;
+
+    goto_tube(tube);
+    start = getMillis();
+    for (index = 0; (count == 0 || index < count) && !pollCancel(); index++)
+    {
+        sample.time = getMillis() - start;
+        sample.r    = readLed(pwm_r, 0, 0);
+        sample.g    = readLed(0, pwm_g, 0);
+        sample.b    = readLed(0, 0, pwm_b);
+        sample.pH   = scalePh(computePh(sample.r, sample.g, sample.b), 1000);
+        reportException(&sample, index == 0);
+
+        //wait for the next sample time, in slices so a cancel is seen promptly
+        due = start + (uint32_t)((uint64_t)(index + 1) * 1000 / rate);
+        while ((int32_t)(getMillis() - due) < 0 && !pollCancel())
+            waitMicrosecond(STREAM_POLL_US);
+    }
+}
+
+//checkProfile() runs round trips to the farthest tube at the present profile, returns false if steps were lost
+bool checkProfile(uint16_t baseline)
+{
+    uint16_t value ;
+    for (ii = 0; ii < CHAR_ROUND_TRIPS && !isCancelRequested(); ii++)
+    {
+        goto_tube(1);
+        goto_tube(0);
+    }
+    value = readReference();
+    return (value > baseline ? value - baseline : baseline - value) <= CHAR_TOLERANCE;
+}
+
+//characterize() finds the fastest step period and shortest ramp that lose no steps, optionally storing them
+void characterize(bool save)
+{
+    MOTION_PROFILE safe = carousel.profile , best = carousel.profile ;
+    uint32_t period , v_start , v_cruise ;
+    uint16_t baseline ;
+    bool     cruise_lost = false , ramp_lost = false ;
+
+    home();
+    if (isCancelRequested())
+        return;
+    baseline = readReference();
+
+    //cruise rate at the default ramp, up to the first rate that loses steps
+    for (period = safe.stepPeriodUs - CHAR_PERIOD_STEP_US; period >= CHAR_MIN_PERIOD_US && !cruise_lost && !isCancelRequested(); period -= CHAR_PERIOD_STEP_US)
+    {
+        carousel.profile.stepPeriodUs = period;
+        if (checkProfile(baseline))
+            best = carousel.profile;
+        else
+            cruise_lost = !isCancelRequested();
+    }
+
+    //position is unknown after lost steps, rehome at the known good profile before the ramp search
+    if (cruise_lost)
+    {
+        carousel.profile = safe;
+        home();
+        if (isCancelRequested())
+            return;
+        baseline = readReference();
+    }
+
+    //shortest ramp at the best cruise rate
+    carousel.profile = best;
+    while (!ramp_lost && !isCancelRequested() && carousel.profile.rampSteps > 0)
+    {
+        carousel.profile.rampSteps--;
+        if (checkProfile(baseline))
+            best = carousel.profile;
+        else
+            ramp_lost = !isCancelRequested();
+    }
+
+    carousel.profile = safe;
+    if (ramp_lost)
+        home();
+    if (isCancelRequested())
+        return;
+
+    putTag();
+    putsUart0("step period:          ");
+    putUintUart0(best.stepPeriodUs, 5);
+    putsUart0(" us\n");
+    putTag();
+    putsUart0("ramp:          ");
+    putUintUart0(best.rampSteps, 4);
+    putsUart0(" steps from ");
+    putUintUart0(best.startPeriodUs, 5);
+    putsUart0(" us\n");
+    if (best.rampSteps > 0)
+    {
+        //a = (v^2 - v0^2) / 2n in steps/s^2
+        v_start  = 1000000 / best.startPeriodUs;
+        v_cruise = 1000000 / best.stepPeriodUs;
+        putTag();
+        putsUart0("acceleration:          ");
+        putUintUart0((v_cruise * v_cruise - v_start * v_start) / (2 * best.rampSteps), 6);
+        putsUart0(" steps/s^2\n");
+    }
+
+    if (save)
+    {
+        carousel.profile = best;
+        saveStepperProfile(&carousel);
+    }
+}
+
+//curveBlockDone() frees a response curve block, called from the UART0 interrupt
+void curveBlockDone(const char *block)
+{
+    curve_busy[block == curve_blocks[1]] = false;
+}
+
+//sendCurveBlock() hands a filled block to uDMA
+void sendCurveBlock(uint8_t block, uint16_t size)
+{
+    curve_busy[block] = true;
+    while (!sendUart0Block(curve_blocks[block], size));
+}
+
+//curve() streams the reading at every LED setting up to the calibrated setpoints, one block is sent while the next is filled
+void curve(uint8_t tube)
+{
+    uint16_t limit[3] = {pwm_r, pwm_g, pwm_b} ;
+    uint16_t size = 0 , i ;
+    uint8_t  block = 0 , color , length ;
+    char     *line ;
+
+    setUart0BlockCallback(curveBlockDone);
+    goto_tube(tube);
+    for (color = 0; color < 3 && !isCancelRequested(); color++)
+    {
+        for (i = 0; i <= limit[color] && !pollCancel(); i++)
+        {
+            setRgbColor(color == 0 ? i : 0, color == 1 ? i : 0, color == 2 ? i : 0);
+            waitMicrosecond(1000);
+            line = &curve_blocks[block][size];
+            length = formatTag(line);
+            line[length++] = "rgb"[color];
+            line[length++] = ',';
+            length += formatUint(&line[length], i, 0);
+            line[length++] = ',';
+            length += formatUint(&line[length], readAdc0Ss3(), 0);
+            line[length++] = '\n';
+            size += length;
+            if (size > CURVE_BLOCK_SIZE - CURVE_LINE_MAX)
+            {
+                sendCurveBlock(block, size);
+                block ^= 1;
+                size = 0;
+                while (curve_busy[block]);          // the other block is still being sent
+            }
+        }
+        setRgbColor(0, 0, 0);
+    }
+    if (size > 0)
+        sendCurveBlock(block, size);
+    flushUart0();
 }
 
 // Initialize Hardware
@@ -268,26 +990,12 @@ void initHw(void)
 {
     // Initialize system clock to 40 MHz
     initSystemClockTo40Mhz();
+    initWait();
 
     // Enable clocks for LED's and PUSH BUTTONS
-    SYSCTL_RCGCWTIMER_R |= SYSCTL_RCGCWTIMER_R2                                         ;
-    SYSCTL_RCGCGPIO_R |= SYSCTL_RCGCGPIO_R1 | SYSCTL_RCGCGPIO_R5 |SYSCTL_RCGCGPIO_R2 |SYSCTL_RCGCGPIO_R3 |SYSCTL_RCGCGPIO_R4 |SYSCTL_RCGCGPIO_R0;
+    SYSCTL_RCGCGPIO_R |= SYSCTL_RCGCGPIO_R1 | SYSCTL_RCGCGPIO_R5 |SYSCTL_RCGCGPIO_R2 |SYSCTL_RCGCGPIO_R4 |SYSCTL_RCGCGPIO_R0;
     _delay_cycles(3);
 
-
-    // Configure SIGNAL_IN for frequency and time measurements
-    GPIO_PORTD_AFSEL_R  |= IR_DATA_IN_MASK                                      ;// select alternative functions for SIGNAL_IN pin
-    GPIO_PORTD_PCTL_R   &= ~GPIO_PCTL_PD0_M                                     ;// map alt fns to SIGNAL_IN
-    GPIO_PORTD_PCTL_R   |= GPIO_PCTL_PD0_WT2CCP0                                ;//writing encoding value in port control register
-    GPIO_PORTD_DEN_R    |= IR_DATA_IN_MASK                                      ;// enable bit 1 for digital input
-
-    //Enable interrupt for PORT D(To call the GPDIsr)
-    NVIC_EN0_R          |= 1 << (INT_GPIOD-16)                                  ;// turn-on interrupt 3 (GPIO port D)
-    GPIO_PORTD_IM_R     &= ~IR_DATA_IN_MASK                                    ;// disable the PD0 interrupt
-    GPIO_PORTD_IS_R     &= ~IR_DATA_IN_MASK                                    ;// clearing the 1st bit of interrupt sense register to make it edge sensitive
-    GPIO_PORTD_IEV_R    &= ~IR_DATA_IN_MASK                                    ;// clearing the 1st bit to make it negative edge trigger
-    GPIO_PORTD_IM_R     |= IR_DATA_IN_MASK                                     ;// enable the PD0 interrupt
-
     // Configure AIN11 as an analog input
     GPIO_PORTB_AFSEL_R |= AIN11_MASK;                 // select alternative functions for AIN11 (PB5)
     GPIO_PORTB_DEN_R &= ~AIN11_MASK;                  // turn off digital operation on pin PB5
@@ -303,181 +1011,692 @@ void initHw(void)
 }
 
 
-//GPIO Port D ISR
-void GPDIsr(void)
+//measureTube() measures one tube and prints the raw readings
+void measureTube(uint8_t tube)
+{
+    if (!measure(tube,&analog_r,&analog_g,&analog_b))
+        return;
+    reportMeasurement(tube, false);
+}
+
+//startOperation() runs an operation in the background, operationTask() steps it and reports its end
+void startOperation(bool (*step)(void), COROUTINE *co)
+{
+    operation       = step;
+    operation_co    = co;
+    operation_tag   = command_tag;
+    setEvent(EVENT_OPERATION);
+}
+
+//isOperationRunning() returns true while an operation started by startOperation() is running
+bool isOperationRunning(void)
+{
+    return operation != 0;
+}
+
+//measureOperation() steps the background measurement and reports it once it has ended
+bool measureOperation(void)
+{
+    if (stepMeasurement(&measurement))
+        return true;
+    analog_r = measurement.reading[COLOR_RED];
+    analog_g = measurement.reading[COLOR_GREEN];
+    analog_b = measurement.reading[COLOR_BLUE];
+    if (!isCancelRequested())
+        reportMeasurement(measurement.tube, measurement.pH);
+    return false;
+}
+
+//calibrateOperation() steps the background calibration
+bool calibrateOperation(void)
+{
+    return stepCalibration(&calibration);
+}
+
+void startMeasureAction(uint8_t tube, bool pH)
+{
+    measurement.pH = pH;
+    startMeasurement(&measurement, tube);
+    startOperation(measureOperation, &measurement.co);
+}
+
+void measureAction(uint8_t tube)
+{
+    startMeasureAction(tube, false);
+}
+
+void measurePhAction(uint8_t tube)
+{
+    startMeasureAction(tube, true);
+}
+
+void homeAction(uint8_t arg)
+{
+    home();
+}
+
+void calibrateAction(uint8_t arg)
+{
+    startCalibration(&calibration);
+    startOperation(calibrateOperation, &calibration.co);
+}
+
+//jogSteps() returns the steps of one jog, ramping while the key is held
+uint8_t jogSteps(uint8_t repeats)
 {
-    //putsUart0("\n Interrupt handler\r\n ");
-    if(count == 0)
+    uint8_t steps = 1;
+    while (repeats >= JOG_RAMP_REPEATS && steps < JOG_MAX_STEPS)
     {
-        WTIMER2_TAV_R = 0           ;
-        time[count] = WTIMER2_TAV_R ;
-        count = count + 1           ;
+        steps <<= 1;
+        repeats -= JOG_RAMP_REPEATS;
     }
-    else if(count == 1)
+    return steps;
+}
+
+void jogCw(uint8_t repeats)
+{
+    STEPPER *motor = &carousel;
+    startStepperSteps(motor, limitStepperSteps(motor, jogSteps(repeats)));
+    runSteppers(&motor, 1);
+}
+
+void jogCcw(uint8_t repeats)
+{
+    STEPPER *motor = &carousel;
+    startStepperSteps(motor, limitStepperSteps(motor, -jogSteps(repeats)));
+    runSteppers(&motor, 1);
+}
+
+//cancelAction() only turns the LEDs off, a running operation is cancelled by busyCommand()
+void cancelAction(uint8_t arg)
+{
+    setRgbColor(0, 0, 0);
+    GREEN_LED = 0;
+}
+
+//runAction() runs one action, shared by the UART commands and the IR keymap
+void runAction(uint8_t action, uint8_t arg)
+{
+    if (action > ACTION_NONE && action < ACTION_COUNT)
+        actions[action].handler(arg);
+}
+
+//queueCommand() queues a line whose first field is a sequence ID, returns false if the line is not tagged
+bool queueCommand(USER_DATA *data)
+{
+    QUEUED_COMMAND *entry ;
+    uint8_t  next = (queue_head + 1) & (QUEUE_SIZE - 1) ;
+    uint8_t  field ;
+    int32_t  tag ;
+
+    //commands never start with a number, '#' is a delimiter
+    if (data->fieldCount == 0 || data->fieldType[0] != 'n')
+        return false;
+    tag = getFieldInteger(data, 0);
+    if (tag < 1 || tag > 65535)
+        reportTaggedStatus(0, STATUS_INVALID_ARGS);
+    else if (next == queue_tail)
+        reportTaggedStatus(tag, STATUS_QUEUE_FULL);
+    else
     {
-        time[count] = WTIMER2_TAV_R ;
-        //check whether this edge is the valid start edge of the IR command
-        if((time[1]-time[0] >= 520000) && (time[1]-time[0] <= 560000))
-        {
-            count = count + 1   ;
-        }
-        else
+        //store the line without its tag field
+        entry       = &command_queue[queue_head];
+        entry->tag  = tag;
+        entry->data = *data;
+        for (field = 1; field < data->fieldCount; field++)
         {
-            count = 0   ;
-           // putsUart0("\n invalid start command \n");
+            entry->data.fieldPosition[field - 1] = data->fieldPosition[field];
+            entry->data.fieldType[field - 1]     = data->fieldType[field];
         }
+        entry->data.fieldCount--;
+        queue_head = next;
+        setEvent(EVENT_COMMAND);
+    }
+    return true;
+}
+
+//busyCommand() handles a line received while an operation is running, only cancel and progress run
+void busyCommand(USER_DATA *data)
+{
+    //tagged commands are queued behind the running one
+    if (isCommand(data, "cancel", 0))
+        requestCancel();
+    else if (isCommand(data, "progress", 0))
+        reportProgress(&measurement);
+    else if (!queueCommand(data))
+        reportTaggedStatus(0, STATUS_BUSY);
+}
+
+//pollBusy() reads the remote and UART0 while an operation is running, only the cancel key and command are accepted
+void pollBusy(void)
+{
+    uint8_t code;
+    if (decodeIr(&code) == IR_CODE && ir_keymap[code].action == ACTION_CANCEL)
+        requestCancel();
+
+    if (pollsUart0(&busy_data))
+        busyCommand(&busy_data);
+}
+
+//endOperation() reports a cancelled operation and leaves the LEDs off, returns true if it was cancelled
+bool endOperation(void)
+{
+    if (!isCancelRequested())
+        return false;
+    setRgbColor(0, 0, 0);
+    GREEN_LED = 0;
+    reportStatus(STATUS_CANCELLED);
+    clearCancel();
+    return true;
+}
+
+//getTube() returns the tube selected by a field (R or 0-5), or NO_TUBE if it is not valid
+uint8_t getTube(USER_DATA *data, uint8_t field)
+{
+    //de referencing the return address to check whether it is character or not
+    if (*(getFieldString(data, field)) == 'R')
+        return 0;
+    Tube_value = (uint8_t) getFieldInteger(data, field);
+    return Tube_value < 6 ? Tube_value : NO_TUBE;
+}
+
+//initKeymap() assigns the default action of each remote key
+void initKeymap(void)
+{
+    uint8_t k;
+    for (k = 0; k < sizeof(default_keys) / sizeof(default_keys[0]); k++)
+    {
+        ir_keymap[default_keys[k].code].action = default_keys[k].action;
+        ir_keymap[default_keys[k].code].arg    = default_keys[k].arg;
     }
+}
+
+//irmapCommand() reassigns a remote key, irmap <hex code> <action> [tube], action none clears it
+void irmapCommand(USER_DATA *data)
+{
+    char    *hex = getFieldString(data, 1) , *end ;
+    int32_t code = strtol(hex, &end, 16) ;
+    uint8_t action , tube ;
 
-    else if(count > 1 && count <34)
+    //the whole field must be a hex code of one byte
+    if (end == hex || *end != '\0' || code < 0 || code > 0xFF)
     {
-        time[count] = WTIMER2_TAV_R                             ;
-        time_diff   = time[count] - time[count-1]               ;
-        //checking whether these bits are valid IR Addr and Data
-        if((time_diff >= 33750 && time_diff <= 56250)||(time_diff >= 78750 && time_diff <= 101250))
-        {
-            count = count + 1   ;
-        }
+        reportStatus(STATUS_INVALID_ARGS);
+        return;
+    }
+    for (action = ACTION_NONE; action < ACTION_COUNT; action++)
+    {
+        if (strcmp(getFieldString(data, 2), actions[action].name) == 0)
+            break;
+    }
+    tube = (action < ACTION_COUNT && actions[action].tubeArg && data->fieldCount > 3) ? getTube(data, 3) : 0;
+    if (action == ACTION_COUNT || tube == NO_TUBE)
+        reportStatus(STATUS_INVALID_KEY);
+    else
+    {
+        ir_keymap[code].action = action;
+        ir_keymap[code].arg    = tube;
+    }
+}
+
+//batchCommand() visits the tubes in the order with least travel, batch measure|measurepH <tube> <tube> ...
+void batchCommand(USER_DATA *data)
+{
+    uint8_t tubes[MAX_FIELDS] , tube_count = 0 , field ;
+    bool    pH  = strcmp(getFieldString(data, 1), "measurepH") == 0 ;
+
+    if (!pH && strcmp(getFieldString(data, 1), "measure") != 0)
+    {
+        reportStatus(STATUS_INVALID_ARGS);
+        return;
+    }
+    for (field = 2; field < data->fieldCount; field++)
+        tubes[tube_count++] = getTube(data, field);
+
+    tube_count = planTubeVisits(&carousel, tubes, tube_count)  ;
+    for (field = 0; field < tube_count && !isCancelRequested(); field++)
+    {
+        //label each text result since the order differs from the command, records carry the tube
+        result_label = tubes[field] ? '0' + tubes[field] : 'R';
+        if (pH)
+            measurepH(tubes[field]);
         else
+            measureTube(tubes[field]);
+    }
+    result_label = 0;
+}
+
+//characterizeCommand() stores the result as the carousel profile when requested, characterize [save]
+void characterizeCommand(USER_DATA *data)
+{
+    characterize(data->fieldCount > 1 && strcmp(getFieldString(data, 1), "save") == 0);
+}
+
+//curveCommand() dumps the sensor response of each LED sweep, curve <tube>
+void curveCommand(USER_DATA *data)
+{
+    curve(getTube(data, 1));
+}
+
+//progressCommand() reports the measurement running in the background, progress
+void progressCommand(USER_DATA *data)
+{
+    reportProgress(&measurement);
+}
+
+//binaryCommand() selects framed records for results, the host sees FRAME_MODE with the protocol version
+void binaryCommand(USER_DATA *data)
+{
+    uint8_t version = FRAME_VERSION ;
+    binary_mode = true;
+    sendFrame(FRAME_MODE, &version, 1);
+}
+
+//textCommand() returns to readable results
+void textCommand(USER_DATA *data)
+{
+    binary_mode = false;
+    putsUart0("\n text mode \n");
+}
+
+//uartstatCommand() reports the most characters queued in each ring and how often it was full, uartstat [clear]
+void uartstatCommand(USER_DATA *data)
+{
+    uint16_t high_water ;
+    uint32_t overflows  ;
+    bool     clear = data->fieldCount > 1 && strcmp(getFieldString(data, 1), "clear") == 0 ;
+    getUart0TxStats(&high_water, &overflows, clear);
+    putResult("tx high water:          ", high_water, 4);
+    putResult("tx overflows:          ", overflows, 6);
+    getUart0RxStats(&high_water, &overflows, clear);
+    putResult("rx high water:          ", high_water, 4);
+    putResult("rx dropped:          ", overflows, 6);
+}
+
+//streamCommand() streams readings of one tube until cancelled, stream <tube> <rate 1-30/s> [count]
+void streamCommand(USER_DATA *data)
+{
+    int32_t rate  = getFieldInteger(data, 2) ;
+    int32_t count = data->fieldCount > 3 ? getFieldInteger(data, 3) : 0 ;
+    if (rate < 1 || rate > STREAM_MAX_RATE || count < 0)
+        reportStatus(STATUS_INVALID_ARGS);
+    else
+        stream(getTube(data, 1), rate, count);
+}
+
+//deadbandCommand() sets the stream deadband, deadband [<counts> <pH thousandths> [heartbeat ms]], no arguments shows it
+void deadbandCommand(USER_DATA *data)
+{
+    if (data->fieldCount == 2)
+    {
+        reportStatus(STATUS_INVALID_ARGS);
+        return;
+    }
+    if (data->fieldCount > 2)
+    {
+        int32_t counts    = getFieldInteger(data, 1) ;
+        int32_t pH        = getFieldInteger(data, 2) ;
+        int32_t heartbeat = data->fieldCount > 3 ? getFieldInteger(data, 3) : 0 ;
+        if (counts < 0 || counts > DEADBAND_MAX_COUNTS || pH < 0 || pH > PH_MAX_THOUSANDTHS
+            || heartbeat < 0 || heartbeat > DEADBAND_MAX_HEARTBEAT_MS)
         {
-            //putsUart0("\n invalid data \n");
-            count = 0   ;
+            reportStatus(STATUS_INVALID_ARGS);
+            return;
         }
+        deadband.counts      = counts;
+        deadband.pH          = pH;
+        deadband.heartbeatMs = heartbeat;
     }
+    putResult("deadband counts:          ", deadband.counts, 4);
+    putResult("deadband pH:          ", deadband.pH, 4);
+    putResult("heartbeat ms:          ", deadband.heartbeatMs, 6);
+}
 
+//autobaud() times a 'U' from the host and switches to the nearest standard rate, returns false if none was seen
+bool autobaud(uint32_t timeoutMs)
+{
+    uint32_t rate = detectUart0Baud(timeoutMs, getSystemClockHz()) ;
+
+    if (rate == 0)
+        return false;
+    setUart0BaudRate(rate, getSystemClockHz());
+
+    //the 'U' was also received at the old rate, drop it and anything it looked like
+    waitMicrosecond(2000);
+    while (kbhitUart0())
+        getcUart0();
+    takeUart0FramingErrors();
+    clearCancel();
+    command_data.charCount = 0;
+    putsUart0("\n");
+    putResult(" baud ", rate, 0);
+    return true;
+}
 
-    if(count > 33)
+//baudCommand() changes the UART0 rate, baud <rate> falls back unless the host sends ok at the new rate, baud auto times a 'U'
+void baudCommand(USER_DATA *data)
+{
+    uint32_t old_rate = getUart0BaudRate() , rate ;
+    uint16_t ms ;
+
+    if (strcmp(getFieldString(data, 1), "auto") == 0)
     {
-        count = 0   ;
-        GREEN_LED=1;
+        putsUart0("\n send U \n");
+        if (!autobaud(AUTOBAUD_TIMEOUT_MS))
+            putsUart0("\n autobaud failed \n");
+        return;
+    }
 
+    rate = getFieldInteger(data, 1);
+    if (rate < BAUD_MIN || rate > BAUD_MAX)
+    {
+        reportStatus(STATUS_INVALID_ARGS);
+        return;
+    }
+    putsUart0("\n");
+    putResult(" send ok at ", rate, 0);
+    setUart0BaudRate(rate, getSystemClockHz());
 
-        ADDR_DATA_REG = 0;
-        for(ii=1;ii<33;ii++)
+    busy_data.charCount = 0;
+    for (ms = 0; ms < BAUD_CONFIRM_MS; ms++)
+    {
+        if (pollsUart0(&busy_data) && isCommand(&busy_data, "ok", 0))
         {
-            time_diff = time[ii+1] - time[ii] ;
-           if(time_diff > 78750 && time_diff < 101250)
-               ADDR_DATA_REG  |= 1 << ii-1  ;
+            putsUart0("\n baud confirmed \n");
+            return;
         }
+        waitMicrosecond(1000);
+    }
+    setUart0BaudRate(old_rate, getSystemClockHz());
+    putsUart0("\n");
+    putResult(" baud reverted to ", old_rate, 0);
+}
 
-        ADDR        = ADDR_DATA_REG          ;
-        NEG_ADDR    = ADDR_DATA_REG >> 8     ;
-        DATA        = ADDR_DATA_REG >> 16    ;
-        NEG_DATA    = ADDR_DATA_REG >> 24    ;
+//dmaCommand() selects uDMA step generation for tube moves, dma on|off
+void dmaCommand(USER_DATA *data)
+{
+    setStepperDmaMode(&carousel, strcmp(getFieldString(data, 1), "on") == 0)  ;
+}
 
+//Command registry, sorted by name for findCommand()
+//args has one letter per argument: t tube (R or 0-5), n number, w word, x hex, upper case is optional, * repeats the last one
+typedef struct _COMMAND
+{
+    const char  *name                       ;
+    const char  *args                       ;
+    uint8_t     action                      ;   // runs an ACTION_xxx with the tube argument, or
+    void        (*handler)(USER_DATA *data) ;   // handles the fields itself
+} COMMAND;
 
-        if(ADDR == (uint8_t)~NEG_ADDR && DATA == (uint8_t)~NEG_DATA)
-        {
-            valid = true    ;
-            code  = DATA    ;
-            //putsUart0("\n True \n");
-        }
+const COMMAND commands[] =
+{
+    {"batch",           "wt*",  ACTION_NONE,        batchCommand        },
+    {"baud",            "w",    ACTION_NONE,        baudCommand         },
+    {"binary",          "",     ACTION_NONE,        binaryCommand       },
+    {"calibrate",       "",     ACTION_CALIBRATE,   0                   },
+    {"cancel",          "",     ACTION_CANCEL,      0                   },
+    {"characterize",    "W",    ACTION_NONE,        characterizeCommand },
+    {"curve",           "t",    ACTION_NONE,        curveCommand        },
+    {"deadband",        "NNN",  ACTION_NONE,        deadbandCommand     },
+    {"dma",             "w",    ACTION_NONE,        dmaCommand          },
+    {"home",            "",     ACTION_HOME,        0                   },
+    {"irmap",           "xwT",  ACTION_NONE,        irmapCommand        },
+    {"jogccw",          "",     ACTION_JOG_CCW,     0                   },
+    {"jogcw",           "",     ACTION_JOG_CW,      0                   },
+    {"measure",         "t",    ACTION_MEASURE,     0                   },
+    {"measurepH",       "t",    ACTION_MEASURE_PH,  0                   },
+    {"progress",        "",     ACTION_NONE,        progressCommand     },
+    {"stream",          "tnN",  ACTION_NONE,        streamCommand       },
+    {"text",            "",     ACTION_NONE,        textCommand         },
+    {"tube",            "t",    ACTION_TUBE,        0                   },
+    {"uartstat",        "W",    ACTION_NONE,        uartstatCommand     },
+};
+
+#define COMMAND_COUNT   (sizeof(commands) / sizeof(commands[0]))
+
+//findCommand() binary searches the registry, returns 0 if the name is not a command
+const COMMAND *findCommand(const char *name)
+{
+    int8_t low = 0 , high = COMMAND_COUNT - 1 , middle ;
+    int    order ;
+
+    while (low <= high)
+    {
+        middle = (low + high) / 2;
+        order  = strcmp(name, commands[middle].name);
+        if (order == 0)
+            return &commands[middle];
+        if (order < 0)
+            high = middle - 1;
         else
-        {
-            valid = false   ;
-            putsUart0("\n Fail \n");
-        }
+            low = middle + 1;
+    }
+    return 0;
+}
 
-        if(code == 0x58) //R
-        {
-            goto_tube(0)    ;
-        }
-        else if(code == 0x54) //L30
-        {
-            goto_tube(1)    ;
-        }
-        else if(code == 0x50) //L30
-        {
-            goto_tube(2)    ;
-        }
-        else if(code == 0x1C) //L30
-        {
-            goto_tube(3)    ;
-        }
-        else if(code == 0x18) //L30
-        {
-            goto_tube(4)    ;
-        }
-        else if(code == 0x14) //L30
-        {
-            goto_tube(5)    ;
-        }
-        else if(code == 0x59) //L30
-        {
-            measure(0,&analog_r,&analog_g,&analog_b)    ;
-            sprintf(str, "(%4u,%4u,%4u)\n", analog_r,analog_g,analog_b);
-            putsUart0(str);
-        }
-        else if(code == 0x55) //L30
-        {
-            measure(1,&analog_r,&analog_g,&analog_b)    ;
-            sprintf(str, "(%4u,%4u,%4u)\n", analog_r,analog_g,analog_b);
-            putsUart0(str);
-        }
-        else if(code == 0x51) //L30
-        {
-            measure(2,&analog_r,&analog_g,&analog_b)    ;
-            sprintf(str, "(%4u,%4u,%4u)\n", analog_r,analog_g,analog_b);
-            putsUart0(str);
-        }
-        else if(code == 0x1D) //L30
-        {
-            measure(3,&analog_r,&analog_g,&analog_b)    ;
-            sprintf(str, "(%4u,%4u,%4u)\n", analog_r,analog_g,analog_b);
-            putsUart0(str);
-        }
-        else if(code == 0x19) //L30
-        {
-            measure(4,&analog_r,&analog_g,&analog_b)    ;
-            sprintf(str, "(%4u,%4u,%4u)\n", analog_r,analog_g,analog_b);
-            putsUart0(str);
-        }
-        else if(code == 0x15) //L30
-        {
-            measure(5,&analog_r,&analog_g,&analog_b)    ;
-            sprintf(str, "(%4u,%4u,%4u)\n", analog_r,analog_g,analog_b);
-            putsUart0(str);
-        }
-        else if(code == 0x45) //L30
-        {
-            measurepH(0)    ;
-        }
-        else if(code == 0x49) //L30
+//checkArgs() checks the fields after the command against its args, reporting the first problem
+bool checkArgs(const char *args, USER_DATA *data)
+{
+    uint8_t field ;
+    char    kind  = 0 ;
+
+    for (field = 1; field < data->fieldCount; field++)
+    {
+        if (*args == '\0')
         {
-            measurepH(1)    ;
+            reportStatus(STATUS_INVALID_ARGS);
+            return false;
         }
-        else if(code == 0x4D) //L30
+        if (*args != '*')
+            kind = *args++;
+        if ((kind == 't' || kind == 'T') && getTube(data, field) == NO_TUBE)
         {
-            measurepH(2)    ;
+            reportStatus(STATUS_INVALID_TUBE);
+            return false;
         }
-        else if(code == 0x1E) //L30
+        if ((kind == 'n' || kind == 'N') && data->fieldType[field] != 'n')
         {
-            measurepH(3)    ;
+            reportStatus(STATUS_INVALID_ARGS);
+            return false;
         }
-        else if(code == 0x1A) //L30
+    }
+
+    //the arguments not given must be optional
+    for ( ; *args != '\0'; args++)
+    {
+        if (*args >= 'a' && *args <= 'z')
         {
-            measurepH(4)    ;
+            reportStatus(STATUS_INVALID_ARGS);
+            return false;
         }
-        else if(code == 0x16) //L30
+    }
+    return true;
+}
+
+//processCommand() runs one command line received on UART0, already split into fields by pollsUart0()
+void processCommand(USER_DATA *data)
+{
+    const COMMAND *command ;
+
+#ifdef DEBUG
+    for( ii = 0;ii < data->fieldCount ;ii++){
+        putcUart0(data->fieldType[ii]);
+        putsUart0("\t");
+        putsUart0(&(data->buffer[data->fieldPosition[ii]]));
+        putsUart0("\n");
+    }
+#endif
+
+    if (data->fieldCount == 0)
+        return;
+    command = findCommand(getFieldString(data, 0));
+    if (command == 0)
+        reportStatus(STATUS_INVALID_COMMAND);
+    else if (checkArgs(command->args, data))
+    {
+        //commands that share an action with the IR keymap
+        if (command->action != ACTION_NONE)
+            runAction(command->action, command->args[0] == 't' ? getTube(data, 1) : 0);
+        else
+            command->handler(data);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Main
+//-----------------------------------------------------------------------------
+
+//irTask() decodes IR frames captured by the edge interrupt and runs the mapped actions
+void irTask(uint32_t events)
+{
+    uint8_t code ;
+    uint8_t result ;
+
+    while ((result = decodeIr(&code)) != IR_NONE)
+    {
+        //only the cancel key acts while an operation is running
+        if (isOperationRunning())
         {
-            measurepH(5)    ;
+            if (result == IR_CODE && ir_keymap[code].action == ACTION_CANCEL)
+                requestCancel();
+            continue;
         }
-        else if(code == 0x5C) //Brightup
+
+        switch (result)
         {
-            home()  ;
+        case IR_CODE:
+            GREEN_LED = 1;
+            ir_repeats = 0;
+            clearCancel();
+            runAction(ir_keymap[code].action, ir_keymap[code].arg);
+            endOperation();
+            break;
+        case IR_REPEAT:
+            //only jog keys act while held, the repeat count sets the speed
+            if (ir_keymap[code].action == ACTION_JOG_CW || ir_keymap[code].action == ACTION_JOG_CCW)
+            {
+                if (ir_repeats < 255)
+                    ir_repeats++;
+                clearCancel();
+                runAction(ir_keymap[code].action, ir_repeats);
+                endOperation();
+            }
+            break;
+        case IR_ERROR:
+            reportStatus(STATUS_IR_FAIL);
+            break;
         }
-        else if(code == 0x5D) //Bright down
+    }
+}
+
+//framingErrorsRepeated() counts framing errors, returns true once enough arrive within the window to suggest another baud rate
+bool framingErrorsRepeated(void)
+{
+    uint8_t errors = takeUart0FramingErrors() ;
+
+    if (errors == 0)
+        return false;
+    if (framing_errors == 0 || getMillis() - framing_start_ms > AUTOBAUD_FRAMING_WINDOW_MS)
+    {
+        framing_errors   = 0;
+        framing_start_ms = getMillis();
+    }
+    framing_errors = framing_errors + errors > AUTOBAUD_FRAMING_ERRORS ? AUTOBAUD_FRAMING_ERRORS : framing_errors + errors;
+    return framing_errors >= AUTOBAUD_FRAMING_ERRORS;
+}
+
+//uartTask() runs a command once its line is complete, tagged lines wait their turn in the queue
+void uartTask(uint32_t events)
+{
+    //repeated characters at another rate arm autobaud, the host repeats 'U' at its rate until it sees the baud report
+    if (framingErrorsRepeated() && !isOperationRunning())
+    {
+        framing_errors = 0;
+        autobaud(AUTOBAUD_RETRY_MS);
+    }
+
+    while (pollsUart0(&command_data))
+    {
+#ifdef DEBUG
+        //print the string
+        putsUart0(command_data.buffer);
+        putsUart0("\n");
+#endif
+        if (isOperationRunning())
+            busyCommand(&command_data);
+        else if (!queueCommand(&command_data))
         {
-            calibrate()  ;
+            clearCancel();
+            processCommand(&command_data);
+            endOperation();
         }
     }
+}
 
-    GPIO_PORTD_ICR_R |= IR_DATA_IN_MASK;           // clear interrupt flag
+//finishCommand() ends the oldest queued command, a cancel also drops the commands behind it
+void finishCommand(bool cancelled)
+{
+    reportDone();
+    setCommandTag(0);
+    queue_tail = (queue_tail + 1) & (QUEUE_SIZE - 1);
 
+    while (cancelled && queue_tail != queue_head)
+    {
+        reportTaggedStatus(command_queue[queue_tail].tag, STATUS_CANCELLED);
+        queue_tail = (queue_tail + 1) & (QUEUE_SIZE - 1);
+    }
+    if (queue_tail != queue_head)
+        setEvent(EVENT_COMMAND);
 }
 
-//-----------------------------------------------------------------------------
-// Main
-//-----------------------------------------------------------------------------
+//commandTask() runs the oldest queued command, one per run so lines and remote keys are read in between
+//A command that starts a background operation stays at the front of the queue until operationTask() finishes it
+void commandTask(uint32_t events)
+{
+    if (queue_tail == queue_head || isOperationRunning())
+        return;
+    setCommandTag(command_queue[queue_tail].tag);
+    clearCancel();
+    processCommand(&command_queue[queue_tail].data);
+    if (isOperationRunning())
+    {
+        setCommandTag(0);
+        return;
+    }
+    finishCommand(endOperation());
+}
+
+//stepperTask() stores the carousel position once a session of moves is over
+void stepperTask(uint32_t events)
+{
+    flushStepperState(&carousel);
+}
+
+//operationTask() steps the background operation, then reports its end and lets the queue continue
+void operationTask(uint32_t events)
+{
+    if (!isOperationRunning())
+        return;
+    setCommandTag(operation_tag);
+    if (operation())
+    {
+        //the next step is due when the present delay ends, the scheduler sleeps until then
+        setCommandTag(0);
+        setEventAfter(EVENT_OPERATION, CO_WAIT_US(operation_co));
+        return;
+    }
+
+    operation = 0;
+    if (operation_tag != 0)
+        finishCommand(endOperation());
+    else
+    {
+        endOperation();
+        setCommandTag(0);
+        if (queue_tail != queue_head)
+            setEvent(EVENT_COMMAND);
+    }
+}
 
 int main(void)
 {
@@ -489,11 +1708,19 @@ int main(void)
     initAdc0Ss3();
     //Initialize RGB
     initRgb();
+    //Initialize uDMA
+    initUdma();
+    //Initialize the deferred work queue and the 1 ms timebase
+    initDeferredWork();
+    initTick(getSystemClockHz());
 
 
     // Setup UART0 baud rate
-    setUart0BaudRate(115200, 40e6);
-    enableWideTimer()   ;
+    setUart0BaudRate(115200, getSystemClockHz());
+    //Initialize IR receiver
+    initIr();
+    initKeymap();
+    setCancelPoll(pollBusy);
 
     //Blink the Green LED to ensure Program is running
     GREEN_LED        = 1    ;
@@ -508,98 +1735,15 @@ int main(void)
     setAdc0Ss3Log2AverageCount(2);//(Refer 13.3.3 in data sheet)
 
     calibrate() ;
+    endOperation();
 
-    USER_DATA data ;
+    //Tasks run on the events raised by the interrupts
+    addTask(irTask, 0, EVENT_IR_EDGE);
+    addTask(uartTask, 0, EVENT_UART_RX);
+    addTask(commandTask, 0, EVENT_COMMAND);
+    addTask(operationTask, 0, EVENT_OPERATION);
+    addTask(stepperTask, STEPPER_SAVE_IDLE_MS / 4, 0);
 
     while (1)
-    {
-        //Get the String from user
-        getsUart0(&data);
-
-#ifdef DEBUG
-        //print the string
-        putsUart0(data.buffer);
-        putsUart0("\n");
-#endif
-        //Parse fields
-        parseFields(&data);
-
-#ifdef DEBUG
-        for( ii = 0;ii < data.fieldCount ;ii++){
-            putcUart0(data.fieldType[ii]);
-            putsUart0("\t");
-            putsUart0(&(data.buffer[data.fieldPosition[ii]]));
-            putsUart0("\n");
-        }
-#endif
-
-        if (isCommand(&data, "calibrate", 0))
-            calibrate();
-        else if (isCommand(&data, "tube", 2))
-        {
-            //de referencing the return address to check whether it is character or not
-            if (*(getFieldString(&data, 1)) == 'R')
-            {
-                goto_tube(0)    ;
-            }
-            else
-            {
-                Tube_value = (uint8_t) getFieldInteger(&data, 1);
-
-                if (Tube_value < 6){
-                    goto_tube(Tube_value)    ;
-                }
-                else
-                    putsUart0("\n invalid Tube Selection ");
-            }
-
-        }
-        else if (isCommand(&data, "measurepH", 2))
-        {
-            //de referencing the return address to check whether it is character or not
-            if (*(getFieldString(&data, 1)) == 'R')
-            {
-                measurepH(0)    ;
-            }
-            else
-            {
-                Tube_value = (uint8_t) getFieldInteger(&data, 1);
-
-                if (Tube_value < 6){
-                    measurepH(Tube_value)    ;
-                }
-                else
-                    putsUart0("\n invalid Tube Selection ");
-            }
-
-        }
-        else if (isCommand(&data, "measure", 2))
-        {
-            //de referencing the return address to check whether it is character or not
-            if (*(getFieldString(&data, 1)) == 'R')
-            {
-               measure(0,&analog_r,&analog_g,&analog_b)    ;
-               sprintf(str, "(%4u,%4u,%4u)\n", analog_r,analog_g,analog_b);
-               putsUart0(str);
-                //measurepH(0)    ;
-            }
-            else
-            {
-                Tube_value = (uint8_t) getFieldInteger(&data, 1);
-
-                if (Tube_value < 6){
-                     measure(Tube_value,&analog_r,&analog_g,&analog_b)    ;
-                     sprintf(str, "(%4u,%4u,%4u)\n", analog_r,analog_g,analog_b);
-                     putsUart0(str);
-                    //measurepH(Tube_value)    ;
-                }
-                else
-                    putsUart0("\n invalid Tube Selection ");
-            }
-
-        }
-        else if (isCommand(&data, "home", 0))
-        home();
-    }
-
+        runScheduler();
 }
@@ -0,0 +1,108 @@
+// NVIC Priority and Deferred Work Library
+// Mourya
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+// Interrupt handlers queue work with deferWork(), PendSV runs it at the lowest priority once no handler is active
+// Work runs in order, it may be preempted by any interrupt but never by other deferred work
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "tm4c123gh6pm.h"
+#include "nvic.h"
+
+typedef struct _DEFERRED
+{
+    void        (*work)(uint32_t arg)   ;
+    uint32_t    arg                     ;
+} DEFERRED;
+
+//-----------------------------------------------------------------------------
+// Global variables
+//-----------------------------------------------------------------------------
+
+DEFERRED            deferred[DEFERRED_QUEUE_SIZE]   ;
+volatile uint8_t    deferred_head       = 0         ;   // written by deferWork only
+volatile uint8_t    deferred_tail       = 0         ;   // written by pendSvIsr only
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+//setNvicPriority() sets the priority of an interrupt (INT_xxx) or of the PendSV and SysTick exceptions
+void setNvicPriority(uint8_t interrupt, uint8_t priority)
+{
+    volatile uint32_t *reg  ;
+    uint8_t shift           ;
+
+    if(interrupt == EXC_PENDSV)
+    {
+        NVIC_SYS_PRI3_R = (NVIC_SYS_PRI3_R & ~NVIC_SYS_PRI3_PENDSV_M) | (priority << NVIC_SYS_PRI3_PENDSV_S)   ;
+        return  ;
+    }
+    if(interrupt == EXC_SYSTICK)
+    {
+        NVIC_SYS_PRI3_R = (NVIC_SYS_PRI3_R & ~NVIC_SYS_PRI3_TICK_M) | (priority << NVIC_SYS_PRI3_TICK_S)       ;
+        return  ;
+    }
+    if(interrupt < 16)
+        return  ;
+
+    //four interrupts per register, the priority is in the top 3 bits of each byte
+    reg     = &NVIC_PRI0_R + (interrupt - 16) / 4   ;
+    shift   = 8 * ((interrupt - 16) % 4) + 5        ;
+    *reg    = (*reg & ~(7 << shift)) | (priority << shift)  ;
+}
+
+//initDeferredWork() gives PendSV the lowest priority so deferred work never delays an interrupt
+void initDeferredWork(void)
+{
+    setNvicPriority(EXC_PENDSV, PRIORITY_DEFERRED)  ;
+}
+
+//deferWork() queues work(arg) to run from PendSV, returns false if the queue is full
+//Callable from any interrupt handler or from main
+bool deferWork(void (*work)(uint32_t arg), uint32_t arg)
+{
+    uint32_t    primask         ;
+    uint8_t     next            ;
+    bool        queued = false  ;
+
+    //handlers of different priorities may queue at once, restore PRIMASK in case the caller had it set
+    primask = _disable_IRQ()    ;
+    next = (deferred_head + 1) & (DEFERRED_QUEUE_SIZE - 1)  ;
+    if(next != deferred_tail)
+    {
+        deferred[deferred_head].work    = work  ;
+        deferred[deferred_head].arg     = arg   ;
+        deferred_head   = next                  ;
+        queued          = true                  ;
+    }
+    _restore_interrupts(primask)    ;
+
+    NVIC_INT_CTRL_R = NVIC_INT_CTRL_PEND_SV ;
+    return queued   ;
+}
+
+//PendSV ISR, runs the queued work in order
+void pendSvIsr(void)
+{
+    DEFERRED *entry ;
+    while(deferred_tail != deferred_head)
+    {
+        entry = &deferred[deferred_tail]    ;
+        entry->work(entry->arg)             ;
+        deferred_tail = (deferred_tail + 1) & (DEFERRED_QUEUE_SIZE - 1) ;
+    }
+}
+
@@ -0,0 +1,45 @@
+// NVIC Priority and Deferred Work Library
+// Mourya
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef NVIC_H_
+#define NVIC_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// System exception numbers, interrupts use INT_xxx from tm4c123gh6pm.h
+#define EXC_PENDSV          14
+#define EXC_SYSTICK         15
+
+// Interrupt priorities, 0 is the highest of the 8 levels
+// Time-critical capture runs first, longer handlers hand their work down to PendSV
+#define PRIORITY_CAPTURE    0       // WTIMER2A IR edge capture
+#define PRIORITY_ADC        1       // ADC0 sample sequencers, reserved while the ADC is polled
+#define PRIORITY_TICK       2       // SysTick timebase
+#define PRIORITY_UART       3       // UART0 FIFOs and its uDMA completion
+#define PRIORITY_WAIT       4       // Timer 1A, ends a waitMicrosecond()
+#define PRIORITY_DEFERRED   7       // PendSV, runs the deferred work queue
+
+#define DEFERRED_QUEUE_SIZE 16      // must be a power of 2
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void setNvicPriority(uint8_t interrupt, uint8_t priority)       ;
+void initDeferredWork(void)                                     ;
+bool deferWork(void (*work)(uint32_t arg), uint32_t arg)        ;
+
+#endif
@@ -0,0 +1,165 @@
+// Cooperative Scheduler Library
+// Mourya
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+// Tasks run to completion from runScheduler(), each one when its period has elapsed or one of its events is set
+// A task receives the events that woke it, they are cleared before it runs
+// With no task runnable the core sleeps until an interrupt, SysTick ends the sleep every millisecond
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "tick.h"
+#include "wait.h"
+#include "scheduler.h"
+
+typedef struct _TASK
+{
+    void        (*run)(uint32_t events) ;
+    uint32_t    periodMs                ;   // 0 runs on events only
+    uint32_t    dueMs                   ;
+    uint32_t    eventMask               ;
+} TASK;
+
+//-----------------------------------------------------------------------------
+// Global variables
+//-----------------------------------------------------------------------------
+
+TASK                tasks[MAX_TASKS]        ;
+uint8_t             task_count      = 0     ;
+volatile uint32_t   pending_events  = 0     ;
+uint32_t            task_events     = 0     ;   // events some task runs on
+uint32_t            timed_events    = 0     ;   // set by runScheduler() once timed_us has passed since timed_start
+uint32_t            timed_start     = 0     ;
+uint32_t            timed_us        = 0     ;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+//addTask() adds a task run every periodMs and on any event of eventMask, returns its id or NO_TASK
+uint8_t addTask(void (*run)(uint32_t events), uint32_t periodMs, uint32_t eventMask)
+{
+    TASK *task ;
+    if(task_count == MAX_TASKS)
+        return NO_TASK  ;
+    task            = &tasks[task_count]        ;
+    task->run       = run                       ;
+    task->periodMs  = periodMs                  ;
+    task->dueMs     = getMillis() + periodMs    ;
+    task->eventMask = eventMask                 ;
+    task_events     |= eventMask                ;
+    return task_count++ ;
+}
+
+//setTaskPeriod() changes the period of a task, 0 stops its timed runs
+void setTaskPeriod(uint8_t task, uint32_t periodMs)
+{
+    tasks[task].periodMs    = periodMs                  ;
+    tasks[task].dueMs       = getMillis() + periodMs    ;
+}
+
+//setEvent() sets event flags, callable from interrupts
+//Restores PRIMASK rather than enabling interrupts, so it is also safe inside a CPSID section
+void setEvent(uint32_t events)
+{
+    uint32_t primask    ;
+
+    primask         = _disable_IRQ()    ;
+    pending_events  |= events           ;
+    _restore_interrupts(primask)        ;
+}
+
+//timedRemainingUs() returns the time left before the timed events are set
+uint32_t timedRemainingUs(void)
+{
+    uint32_t elapsed = getMicros() - timed_start    ;
+    return elapsed >= timed_us ? 0 : timed_us - elapsed ;
+}
+
+//setEventAfter() sets event flags once us microseconds have passed, callable from tasks
+//Events timed before the present deadline are set with it, those timed after are set early
+void setEventAfter(uint32_t events, uint32_t us)
+{
+    if(us == 0)
+    {
+        setEvent(events)    ;
+        return  ;
+    }
+    if(timed_events == 0 || us < timedRemainingUs())
+    {
+        timed_start = getMicros()   ;
+        timed_us    = us            ;
+    }
+    timed_events |= events  ;
+}
+
+//idleScheduler() sleeps until an interrupt or the timed events, unless an event arrived since the tasks were checked
+void idleScheduler(void)
+{
+    uint32_t primask    ;
+    uint32_t us = 0     ;
+
+    if(timed_events != 0)
+    {
+        us = timedRemainingUs() ;
+        if(us == 0)
+            return  ;
+    }
+    primask = _disable_IRQ()    ;
+    if((pending_events & task_events) == 0)
+        sleepMicrosecond(us)    ;
+    _restore_interrupts(primask)    ;
+}
+
+//runScheduler() gives every task that is due or has events one run, then sleeps if none had work
+void runScheduler(void)
+{
+    TASK     *task  ;
+    uint32_t events ;
+    uint8_t  k      ;
+    bool     due    ;
+    bool     ran    = false ;
+
+    if(timed_events != 0 && timedRemainingUs() == 0)
+    {
+        setEvent(timed_events)  ;
+        timed_events = 0        ;
+    }
+
+    for(k = 0 ; k < task_count ; k++)
+    {
+        task = &tasks[k]    ;
+
+        __asm("    CPSID I")    ;
+        events          = pending_events & task->eventMask  ;
+        pending_events  &= ~events                          ;
+        __asm("    CPSIE I")    ;
+
+        due = task->periodMs != 0 && (int32_t)(getMillis() - task->dueMs) >= 0 ;
+        if(due)
+        {
+            //keep the period phase, skip missed runs after a long blocking operation
+            task->dueMs += task->periodMs   ;
+            if((int32_t)(getMillis() - task->dueMs) >= 0)
+                task->dueMs = getMillis() + task->periodMs  ;
+        }
+        if(due || events != 0)
+        {
+            task->run(events)   ;
+            ran = true          ;
+        }
+    }
+    if(!ran)
+        idleScheduler() ;
+}
@@ -0,0 +1,41 @@
+// Cooperative Scheduler Library
+// Mourya
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef SCHEDULER_H_
+#define SCHEDULER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define MAX_TASKS           8
+#define NO_TASK             0xFF
+
+// Event flags, set from interrupts or tasks with setEvent()
+#define EVENT_UART_RX       0x00000001      // uart0Isr queued received characters
+#define EVENT_IR_EDGE       0x00000002      // wideTimer2Isr queued an edge
+#define EVENT_COMMAND       0x00000004      // a tagged command is waiting in the queue
+#define EVENT_OPERATION     0x00000008      // a background operation is running, set again by each step
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+uint8_t addTask(void (*run)(uint32_t events), uint32_t periodMs, uint32_t eventMask)    ;
+void setTaskPeriod(uint8_t task, uint32_t periodMs)                                     ;
+void setEvent(uint32_t events)                                                          ;
+void setEventAfter(uint32_t events, uint32_t us)                                        ;
+void runScheduler(void)                                                                 ;
+
+#endif
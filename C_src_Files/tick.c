@@ -0,0 +1,69 @@
+// System Timebase Library
+// Mourya
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    40 MHz
+
+// SysTick interrupts every millisecond from the system clock
+// getMillis() wraps after 49 days and getMicros() after 71 minutes, compare times by subtraction
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "tm4c123gh6pm.h"
+#include "tick.h"
+#include "nvic.h"
+
+//-----------------------------------------------------------------------------
+// Global variables
+//-----------------------------------------------------------------------------
+
+volatile uint32_t tick_ms       = 0 ;   // written by sysTickIsr only
+uint32_t          ticks_per_us  = 40    ;
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+//initTick() starts the 1 ms SysTick interrupt
+void initTick(uint32_t fcyc)
+{
+    ticks_per_us        = fcyc / 1000000                                        ;
+    NVIC_ST_CTRL_R      = 0                                                     ;// turn-off SysTick before reconfiguring
+    NVIC_ST_RELOAD_R    = fcyc / 1000 - 1                                       ;// 1 ms period
+    NVIC_ST_CURRENT_R   = 0                                                     ;
+    setNvicPriority(EXC_SYSTICK, PRIORITY_TICK)                                 ;
+    NVIC_ST_CTRL_R      = NVIC_ST_CTRL_CLK_SRC | NVIC_ST_CTRL_INTEN | NVIC_ST_CTRL_ENABLE ;// system clock, interrupt on wrap
+}
+
+//SysTick ISR
+void sysTickIsr(void)
+{
+    tick_ms++   ;
+}
+
+//getMillis() returns the milliseconds since initTick()
+uint32_t getMillis(void)
+{
+    return tick_ms  ;
+}
+
+//getMicros() returns the microseconds since initTick(), SysTick counts down within each millisecond
+uint32_t getMicros(void)
+{
+    uint32_t ms , count ;
+    do
+    {
+        ms      = tick_ms           ;
+        count   = NVIC_ST_CURRENT_R ;
+    } while(ms != tick_ms)  ;
+    return ms * 1000 + (NVIC_ST_RELOAD_R - count) / ticks_per_us    ;
+}
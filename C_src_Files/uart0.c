@@ -24,15 +24,59 @@
 #include "string.h"
 #include "tm4c123gh6pm.h"
 #include "uart0.h"
+#include "udma.h"
+#include "cancel.h"
+#include "scheduler.h"
+#include "nvic.h"
+#include "nvic.h"
 
 // PortA masks
 #define UART_TX_MASK 2
 #define UART_RX_MASK 1
 
+// Autobaud, the host sends 'U' (0x55) so the start bit to the stop bit is 9 bit times with 5 rising edges
+#define AUTOBAUD_BITS 9
+#define AUTOBAUD_RISES 5
+#define AUTOBAUD_IDLE_US 250                            // line high for over 2 bits at 9600 ends the character
+
+// Transmit and receive rings, sizes must be powers of 2
+#define TX_RING_SIZE 256
+#define RX_RING_SIZE 128
+
+// uDMA block transmit, 8-bit items to the data register, bursts of 4 once the fifo is half empty
+#define TX_BLOCK_MAX 1024
+#define TX_BLOCK_CONTROL (UDMA_CHCTL_DSTINC_NONE | UDMA_CHCTL_DSTSIZE_8 | UDMA_CHCTL_SRCINC_8 | UDMA_CHCTL_SRCSIZE_8 | UDMA_CHCTL_ARBSIZE_4 | UDMA_CHCTL_XFERMODE_BASIC)
+
 //-----------------------------------------------------------------------------
 // Global variables
 //-----------------------------------------------------------------------------
 
+uint32_t uart0_baud = 115200;                           // present baud rate
+
+// Standard rates that autobaud snaps to
+const uint32_t standard_bauds[] = {9600, 19200, 38400, 57600, 115200, 230400, 460800, 921600};
+
+// Single-producer (uart0Isr) / single-consumer (getcUart0) receive ring
+char rx_ring[RX_RING_SIZE];
+volatile uint8_t rx_head = 0;                           // written by uart0Isr only
+volatile uint8_t rx_tail = 0;                           // written by getcUart0 only
+uint8_t rx_high_water = 0;                              // most characters waiting in the ring
+uint32_t rx_overflow = 0;                               // characters dropped with the ring full
+volatile uint8_t rx_framing_errors = 0;                 // characters that arrived at another baud rate
+
+// Single-producer (putcUart0) / single-consumer (uart0Isr) transmit ring
+char tx_ring[TX_RING_SIZE];
+volatile uint16_t tx_head = 0;                          // written by putcUart0 only
+volatile uint16_t tx_tail = 0;                          // written by fillUart0Fifo only
+uint16_t tx_high_water = 0;                             // most characters waiting in the ring
+uint32_t tx_overflow = 0;                               // characters that found the ring full
+
+// Double-buffered uDMA transmit, one block is sent while the next one waits
+const char * volatile tx_block = 0;                     // block being sent
+const char * volatile tx_next_block = 0;                // block waiting for the ring and the present block
+uint16_t tx_next_size = 0;
+void (*tx_block_done)(const char *block) = 0;           // called from uart0Isr once a block has been read
+
 //-----------------------------------------------------------------------------
 // Subroutines
 //-----------------------------------------------------------------------------
@@ -59,8 +103,12 @@ void initUart0()
     UART0_IBRD_R = 21;                                  // r = 40 MHz / (Nx115.2kHz), set floor(r)=21, where N=16
     UART0_FBRD_R = 45;                                  // round(fract(r)*64)=45
     UART0_LCRH_R = UART_LCRH_WLEN_8 | UART_LCRH_FEN;    // configure for 8N1 w/ 16-level FIFO
+    UART0_IFLS_R = UART_IFLS_TX4_8 | UART_IFLS_RX1_8;   // TX interrupt once the FIFO drains to half full, RX at 2 characters
     UART0_CTL_R = UART_CTL_TXE | UART_CTL_RXE | UART_CTL_UARTEN;
                                                         // enable TX, RX, and module
+    UART0_IM_R = UART_IM_RXIM | UART_IM_RTIM;           // receive and receive time-out (a lone character) interrupts
+    setNvicPriority(INT_UART0, PRIORITY_UART);
+    NVIC_EN0_R |= 1 << (INT_UART0-16);                  // turn-on interrupt 21 (UART0), TXIM is set while the ring holds characters
 }
 
 // Set baud rate as function of instruction cycle frequency
@@ -68,6 +116,8 @@ void setUart0BaudRate(uint32_t baudRate, uint32_t fcyc)
 {
     uint32_t divisorTimes128 = (fcyc * 8) / baudRate;   // calculate divisor (r) in units of 1/128,
                                                         // where r = fcyc / 16 * baudRate
+    flushUart0();                                       // send queued characters at the old rate
+    uart0_baud = baudRate;
     UART0_CTL_R = 0;                                    // turn-off UART0 to allow safe programming
     UART0_IBRD_R = divisorTimes128 >> 7;                // set integer value to floor(r)
     UART0_FBRD_R = ((divisorTimes128 + 1) >> 1) & 63;   // set fractional value to round(fract(r)*64)
@@ -76,153 +126,357 @@ void setUart0BaudRate(uint32_t baudRate, uint32_t fcyc)
                                                         // turn-on UART0
 }
 
-// Blocking function that writes a serial character when the UART buffer is not full
-void putcUart0(char c)
+// Moves characters from the ring to the tx fifo, then starts the waiting block once the ring is empty
+// The TX interrupt stays enabled while characters remain, the ring waits while a block is sent
+// Called by uart0Isr or through kickUart0()
+void fillUart0Fifo()
 {
-    while (UART0_FR_R & UART_FR_TXFF);               // wait if uart0 tx fifo full
-    UART0_DR_R = c;                                  // write character to fifo
+    if (tx_block != 0)
+    {
+        UART0_IM_R &= ~UART_IM_TXIM;
+        return;
+    }
+    while ((tx_tail != tx_head) && !(UART0_FR_R & UART_FR_TXFF))
+    {
+        UART0_DR_R = tx_ring[tx_tail];
+        tx_tail = (tx_tail + 1) & (TX_RING_SIZE - 1);
+    }
+    if (tx_tail != tx_head)
+        UART0_IM_R |= UART_IM_TXIM;
+    else
+    {
+        UART0_IM_R &= ~UART_IM_TXIM;
+        if (tx_next_block != 0)
+        {
+            setUdmaTransfer(UDMA_CH_UART0_TX, false, &tx_next_block[tx_next_size - 1], &UART0_DR_R, TX_BLOCK_CONTROL | ((uint32_t)(tx_next_size - 1) << UDMA_CHCTL_XFERSIZE_S));
+            tx_block = tx_next_block;
+            tx_next_block = 0;
+            UART0_DMACTL_R |= UART_DMACTL_TXDMAE;       // fifo requests go to channel 9
+            enableUdmaChannel(UDMA_CH_UART0_TX);
+        }
+    }
 }
 
-// Blocking function that writes a string when the UART buffer is not full
-void putsUart0(char* str)
+// Runs fillUart0Fifo() from the main line with the UART0 interrupt held off
+void kickUart0()
 {
-    uint32_t i = 0;
-    while (str[i] != '\0')
-        putcUart0(str[i++]);
+    NVIC_DIS0_R = 1 << (INT_UART0-16);
+    fillUart0Fifo();
+    NVIC_EN0_R = 1 << (INT_UART0-16);
 }
 
-// Blocking function that returns with serial data once the buffer is not empty
-char getcUart0()
+// Runs the block callback from PendSV, the argument is the block read by uDMA
+void runUart0BlockCallback(uint32_t block)
 {
-    while (UART0_FR_R & UART_FR_RXFE);               // wait if uart0 rx fifo empty
-    return UART0_DR_R & 0xFF;                        // get character from fifo
+    if (tx_block_done != 0)
+        tx_block_done((const char *)block);
 }
 
-void getsUart0(USER_DATA *struct_data)
+// UART0 interrupt, empties the rx fifo into the ring, refills the tx fifo from the ring and retires completed blocks
+void uart0Isr()
 {
-    uint32_t i = 0;
-    while (1)
-    {
-        //Getting Character from UART 0
-        struct_data->buffer[i] = getcUart0();
+    const char *block;
+    uint8_t next, count;
+    uint32_t data;
+    char c;
 
-        //checking whether the character is back space or not if back space do not consider that
-        if((struct_data-> buffer[i] == 8)||(struct_data-> buffer[i] == 127))
+    if (UART0_MIS_R & (UART_MIS_RXMIS | UART_MIS_RTMIS))
+    {
+        UART0_ICR_R = UART_ICR_RXIC | UART_ICR_RTIC;    // clear interrupt flags
+        while (!(UART0_FR_R & UART_FR_RXFE))
         {
-             i=i-1;
+            data = UART0_DR_R;
+            if (data & UART_DR_FE)                      // garbled by a baud mismatch, repeats arm autobaud
+            {
+                if (rx_framing_errors < 255)
+                    rx_framing_errors++;
+                continue;
+            }
+            c = data & UART_DR_DATA_M;
+            if (c == 3)                                 // Ctrl-C cancels at once, the tokenizer discards the line
+                requestCancel();
+            next = (rx_head + 1) & (RX_RING_SIZE - 1);
+            if (next == rx_tail)
+                rx_overflow++;
+            else
+            {
+                rx_ring[rx_head] = c;
+                rx_head = next;
+            }
         }
+        count = (rx_head - rx_tail) & (RX_RING_SIZE - 1);
+        if (count > rx_high_water)
+            rx_high_water = count;
+        setEvent(EVENT_UART_RX);
+    }
 
-        //Adding null character if character is carraige return
-        else if(struct_data-> buffer[i] == 13)
-        {
-            struct_data-> buffer[i] = '\0';
-            return;
-        }
+    if (UART0_MIS_R & UART_MIS_TXMIS)
+    {
+        UART0_ICR_R = UART_ICR_TXIC;                    // clear interrupt flag
+        fillUart0Fifo();
+    }
+
+    // uDMA completion is signaled on the UART0 vector
+    if (clearUdmaCompletion(UDMA_CH_UART0_TX))
+    {
+        block = tx_block;
+        tx_block = 0;
+        UART0_DMACTL_R &= ~UART_DMACTL_TXDMAE;
+        fillUart0Fifo();
+        if (!deferWork(runUart0BlockCallback, (uint32_t)block))
+            runUart0BlockCallback((uint32_t)block);
+    }
+}
+
+// Returns the present baud rate
+uint32_t getUart0BaudRate()
+{
+    return uart0_baud;
+}
 
-        //considering all the characters whose ASCII value is above 32
-        else if((struct_data-> buffer[i] >= 32) && (struct_data-> buffer[i] != 127) ){
+// Times a 'U' sent by the host on U0RX (PA0) and returns the nearest standard baud rate, or 0 if none fits
+// Wide Timer 2A free-runs at fcyc (initIr()), UART level and lower interrupts are held off while the character is timed
+uint32_t detectUart0Baud(uint32_t timeoutMs, uint32_t fcyc)
+{
+    uint32_t start = WTIMER2_TAV_R, now, first, rise = 0, idle = fcyc / 1000000 * AUTOBAUD_IDLE_US;
+    uint32_t baud, best = 0, error, best_error = 0xFFFFFFFF, basepri;
+    uint8_t rises = 0, k;
+    bool high = false;
+
+    // wait for an idle line so timing starts on a start bit, not within a character
+    rise = WTIMER2_TAV_R;
+    while ((WTIMER2_TAV_R - rise) <= idle)
+    {
+        if (!(GPIO_PORTA_DATA_R & UART_RX_MASK))
+            rise = WTIMER2_TAV_R;
+        if ((WTIMER2_TAV_R - start) / (fcyc / 1000) >= timeoutMs)
+            return 0;
+    }
+    rise = 0;
 
-            i= i+1;
+    // wait for the start bit
+    while (GPIO_PORTA_DATA_R & UART_RX_MASK)
+    {
+        if ((WTIMER2_TAV_R - start) / (fcyc / 1000) >= timeoutMs)
+            return 0;
+    }
+    // BASEPRI keeps IR capture and SysTick running, they are short enough not to hide a bit
+    basepri = _set_interrupt_priority(PRIORITY_UART << 5);
+    first = WTIMER2_TAV_R;
 
+    // follow the edges until the line stays high, a line held low gives up after 10 ms
+    while (1)
+    {
+        now = WTIMER2_TAV_R;
+        if ((now - first) > fcyc / 100)
+            break;
+        if (GPIO_PORTA_DATA_R & UART_RX_MASK)
+        {
+            if (!high)
+            {
+                rise = now;
+                rises++;
+                high = true;
+            }
+            else if ((now - rise) > idle)
+                break;
         }
+        else
+            high = false;
+    }
+    _set_interrupt_priority(basepri);
+
+    if ((rises != AUTOBAUD_RISES) || (rise == first))
+        return 0;
+    baud = (uint64_t)fcyc * AUTOBAUD_BITS / (rise - first);
 
-        //if maximum characters are received then add the NULL statement
-        if (i == MAX_CHARS)
+    // nearest standard rate, within 5%
+    for (k = 0; k < sizeof(standard_bauds) / sizeof(standard_bauds[0]); k++)
+    {
+        error = (baud > standard_bauds[k]) ? baud - standard_bauds[k] : standard_bauds[k] - baud;
+        if (error < best_error)
         {
-            struct_data->buffer[i + 1] = '\0';
-            return;
+            best_error = error;
+            best = standard_bauds[k];
         }
     }
+    return (best_error * 20 <= best) ? best : 0;
+}
 
+// Returns the characters received with a framing error since the last call
+uint8_t takeUart0FramingErrors()
+{
+    uint32_t primask;
+    uint8_t errors;
+
+    primask = _disable_IRQ();
+    errors = rx_framing_errors;
+    rx_framing_errors = 0;
+    _restore_interrupts(primask);
+    return errors;
 }
 
-//This function checks Transition from Delimiter to alpha or numeric
-void parseFields(USER_DATA *struct_data)
+// Queues a character for the TX interrupt, returns immediately unless the ring is full
+void putcUart0(char c)
 {
-    uint8_t char_count = 0, fieldcount = 0, field_position_type_count = 0;
-    char data1, data2;
+    uint16_t next = (tx_head + 1) & (TX_RING_SIZE - 1);
+    uint16_t count;
 
-    //Run the loop till you hit the NULL character
-    while ((struct_data->buffer[char_count]) != '\0')
+    // ring full, drain by polling so no character is lost
+    if (next == tx_tail)
     {
+        tx_overflow++;
+        while (next == tx_tail)
+            kickUart0();
+    }
 
-        data1 = (struct_data->buffer[char_count])           ;   //Present value
+    tx_ring[tx_head] = c;
+    tx_head = next;
+    count = (tx_head - tx_tail) & (TX_RING_SIZE - 1);
+    if (count > tx_high_water)
+        tx_high_water = count;
 
-        if (char_count > 0)
-            data2 = (struct_data->buffer[char_count - 1])   ;  // Previous value
+    // start the fifo if the TX interrupt is idle
+    kickUart0();
+}
 
-        //First Character Transition is assumed from delimiter
-        if (char_count == 0)
-        {
-            //Checking first character is a number or not
-            if ((data1 > 47 && data1 < 58))
-            {
-                struct_data->fieldPosition[field_position_type_count] = char_count;
-                struct_data->fieldType[field_position_type_count] = 'n';
-                char_count = char_count + 1;
-                fieldcount = fieldcount + 1;
-                field_position_type_count = field_position_type_count + 1;
+// Blocking function that waits until every queued character and block has been sent
+void flushUart0()
+{
+    while ((tx_tail != tx_head) || (tx_block != 0) || (tx_next_block != 0))
+        kickUart0();
+    while (UART0_FR_R & UART_FR_BUSY);                  // wait for the last stop bit
+}
 
-            }
-            //Checking first character is an alphabet or not
-            else if ((data1 > 64 && data1 < 91) || (data1 > 96 && data1 < 123))
+// Returns the receive ring high-water mark and dropped character count, clearing them if requested
+void getUart0RxStats(uint16_t *highWater, uint32_t *overflows, bool clear)
+{
+    *highWater = rx_high_water;
+    *overflows = rx_overflow;
+    if (clear)
+    {
+        rx_high_water = 0;
+        rx_overflow = 0;
+    }
+}
+
+// Returns the ring high-water mark and overflow count, clearing them if requested
+void getUart0TxStats(uint16_t *highWater, uint32_t *overflows, bool clear)
+{
+    *highWater = tx_high_water;
+    *overflows = tx_overflow;
+    if (clear)
+    {
+        tx_high_water = 0;
+        tx_overflow = 0;
+    }
+}
+
+// Sets the function called from PendSV once a block has been read and may be refilled
+void setUart0BlockCallback(void (*callback)(const char *block))
+{
+    tx_block_done = callback;
+}
+
+// Hands a block of up to 1024 characters to uDMA, returns false if a block is already waiting
+// Characters queued by putcUart0() before the block starts are sent ahead of it
+bool sendUart0Block(const char *block, uint16_t size)
+{
+    if ((size == 0) || (size > TX_BLOCK_MAX) || (tx_next_block != 0))
+        return false;
+    tx_next_size = size;
+    tx_next_block = block;
+    kickUart0();
+    return true;
+}
+
+// Writes a string through the transmit ring
+void putsUart0(char* str)
+{
+    uint32_t i = 0;
+    while (str[i] != '\0')
+        putcUart0(str[i++]);
+}
+
+// Blocking function that returns with serial data once the ring is not empty
+char getcUart0()
+{
+    char c;
+    while (rx_tail == rx_head);                      // wait for uart0Isr
+    c = rx_ring[rx_tail];
+    rx_tail = (rx_tail + 1) & (RX_RING_SIZE - 1);
+    return c;
+}
+
+// Returns true for the characters of a field (alpha or numeric), all others are delimiters
+bool isFieldChar(char c)
+{
+    return (c > 47 && c < 58) || (c > 64 && c < 91) || (c > 96 && c < 123);
+}
+
+// Non-blocking function that tokenizes the received characters as they arrive, returns true once carriage return completes the line
+// Delimiters are stored as NULL and the fields are recorded on the way, so the line needs no separate parsing pass
+bool pollsUart0(USER_DATA *struct_data)
+{
+    uint8_t count, field;
+    char c;
+    while (kbhitUart0())
+    {
+        c = getcUart0();
+        count = struct_data->charCount;
+        field = (count == 0) ? 0 : struct_data->fieldCount;
+
+        //back space removes the last character, and its field if it was the first character
+        if ((c == 8) || (c == 127))
+        {
+            if (count > 0)
             {
-                struct_data->fieldPosition[field_position_type_count] = char_count;
-                struct_data->fieldType[field_position_type_count] = 'a';
-                char_count = char_count + 1;
-                fieldcount = fieldcount + 1;
-                field_position_type_count = field_position_type_count + 1;
+                count--;
+                if ((field > 0) && (struct_data->fieldPosition[field - 1] == count))
+                    field--;
             }
-            //If it is not a number or an alphabet then it is a delimiter so just increment the char count we shall replace this with "\0"
-            else
-                char_count = char_count + 1;
+        }
 
+        //carriage return completes the line
+        else if (c == 13)
+        {
+            struct_data->buffer[count] = '\0';
+            struct_data->fieldCount = field;
+            struct_data->charCount = 0;
+            return true;
         }
-        else
+
+        //Ctrl-C discards the line, uart0Isr has already cancelled the running operation
+        else if (c == 3)
+            count = 0;
+
+        //a field character after a delimiter starts a field, once every field slot is used the rest of the line is dropped
+        else if (c >= 32)
         {
-            //Checking whether the old character is a delimiter or not and replacing it with NULL
-            if (!((data2 > 47 && data2 < 58) || (data2 > 64 && data2 < 91) || (data2 > 96 && data2 < 123)))
+            if (!isFieldChar(c))
+                struct_data->buffer[count++] = '\0';
+            else if ((count > 0) && (struct_data->buffer[count - 1] != '\0'))
+                struct_data->buffer[count++] = c;
+            else if (field < MAX_FIELDS)
             {
-                struct_data->buffer[char_count - 1] = '\0';
-
-                //Recording the Transition type
-                if ((data1 > 47 && data1 < 58))
-                {
-                    struct_data->fieldPosition[field_position_type_count] = char_count;
-                    struct_data->fieldType[field_position_type_count] = 'n';
-                    char_count = char_count + 1;
-                    fieldcount = fieldcount + 1;
-                    field_position_type_count = field_position_type_count + 1;
-
-                }
-                else if ((data1 > 64 && data1 < 91)
-                        || (data1 > 96 && data1 < 123))
-                {
-                    struct_data->fieldPosition[field_position_type_count] = char_count;
-                    struct_data->fieldType[field_position_type_count] = 'a';
-                    char_count = char_count + 1;
-                    fieldcount = fieldcount + 1;
-                    field_position_type_count = field_position_type_count + 1;
-                }
-                else
-                {
-                    //Come back here to check whether making NULL is required or not
-                    //struct_data->buffer[char_count] = '\0';
-                    char_count = char_count + 1;
-                }
+                struct_data->fieldPosition[field] = count;
+                struct_data->fieldType[field++] = (c < 58) ? 'n' : 'a';
+                struct_data->buffer[count++] = c;
             }
-            else
-                char_count = char_count + 1;
 
+            if (count == MAX_CHARS)
+            {
+                struct_data->buffer[count] = '\0';
+                struct_data->fieldCount = field;
+                struct_data->charCount = 0;
+                return true;
+            }
         }
 
+        struct_data->charCount = count;
+        struct_data->fieldCount = field;
     }
-
-    if (fieldcount >= MAX_FIELDS)
-        struct_data->fieldCount = MAX_FIELDS;
-    else
-        struct_data->fieldCount = fieldcount;
-
+    return false;
 }
 
 //return the string base address based on field number
@@ -252,10 +506,10 @@ bool isCommand(USER_DATA* data, const char strCommand[],uint8_t minArguments){
         return false    ;
     }
 }
-// Returns the status of the receive buffer
+// Returns the status of the receive ring
 bool kbhitUart0()
 {
-    return !(UART0_FR_R & UART_FR_RXFE);
+    return rx_tail != rx_head;
 }
 
 
@@ -22,10 +22,11 @@
 #define UART0_H_
 
 #define MAX_CHARS 80
-#define MAX_FIELDS 5
+#define MAX_FIELDS 10
 typedef struct _USER_DATA
 {
     char    buffer[MAX_CHARS+1]         ;
+    uint8_t charCount                   ;   // characters of the line in progress (pollsUart0)
     uint8_t fieldCount                  ;
     uint8_t fieldPosition[MAX_FIELDS]   ;
     char    fieldType[MAX_FIELDS]       ;
@@ -37,12 +38,19 @@ typedef struct _USER_DATA
 
 void initUart0()                                                                ;
 void setUart0BaudRate(uint32_t baudRate, uint32_t fcyc)                         ;
+uint32_t getUart0BaudRate()                                                     ;
+uint32_t detectUart0Baud(uint32_t timeoutMs, uint32_t fcyc)                     ;
+uint8_t takeUart0FramingErrors()                                                ;
 void putcUart0(char c)                                                          ;
+void flushUart0()                                                               ;
+void getUart0TxStats(uint16_t *highWater, uint32_t *overflows, bool clear)      ;
+void getUart0RxStats(uint16_t *highWater, uint32_t *overflows, bool clear)      ;
+void setUart0BlockCallback(void (*callback)(const char *block))                 ;
+bool sendUart0Block(const char *block, uint16_t size)                           ;
 void putsUart0(char* str)                                                       ;
 char getcUart0()                                                                ;
-void getsUart0(USER_DATA *struct_data)                                          ;
+bool pollsUart0(USER_DATA *struct_data)                                         ;
 bool kbhitUart0()                                                               ;
-void parseFields(USER_DATA *struct_data)                                        ;
 char* getFieldString(USER_DATA* data, uint8_t fieldNumber)                      ;
 int32_t getFieldInteger(USER_DATA* data, uint8_t fieldNumber)                   ;
 bool isCommand(USER_DATA* data, const char strCommand[],uint8_t minArguments)   ;
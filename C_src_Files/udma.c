@@ -0,0 +1,95 @@
+// uDMA Library
+// Mourya
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    -
+
+// Hardware configuration:
+// uDMA controller with a single 1024-byte aligned control table
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "tm4c123gh6pm.h"
+#include "udma.h"
+
+// Channel control structure (Refer 9.3.4 in data sheet)
+typedef struct _UDMA_CONTROL
+{
+    const volatile void *srcEnd ;
+    volatile void       *dstEnd ;
+    uint32_t            control ;
+    uint32_t            unused  ;
+} UDMA_CONTROL;
+
+//-----------------------------------------------------------------------------
+// Global variables
+//-----------------------------------------------------------------------------
+
+// 32 primary structures followed by 32 alternate structures
+#pragma DATA_ALIGN(udmaTable, 1024)
+UDMA_CONTROL udmaTable[64];
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+// Initialize uDMA controller
+void initUdma()
+{
+    // Enable clocks
+    SYSCTL_RCGCDMA_R |= SYSCTL_RCGCDMA_R0;
+    _delay_cycles(3);
+
+    UDMA_CFG_R = UDMA_CFG_MASTEN;                    // enable controller
+    UDMA_CTLBASE_R = (uint32_t)udmaTable;            // point to control table
+}
+
+// Program the primary or alternate structure of a channel, addresses are the last item of each buffer
+void setUdmaTransfer(uint8_t channel, bool alternate, const volatile void *srcEnd, volatile void *dstEnd, uint32_t control)
+{
+    UDMA_CONTROL *entry = &udmaTable[channel + (alternate ? 32 : 0)];
+    entry->srcEnd = srcEnd;
+    entry->dstEnd = dstEnd;
+    entry->control = control;
+}
+
+// Enable a channel for peripheral requests, starting with the primary structure
+void enableUdmaChannel(uint8_t channel)
+{
+    uint32_t mask = 1 << channel;
+    UDMA_ALTCLR_R = mask;                            // start with primary structure
+    UDMA_USEBURSTCLR_R = mask;                       // respond to single and burst requests
+    UDMA_REQMASKCLR_R = mask;                        // allow peripheral requests
+    UDMA_ENASET_R = mask;
+}
+
+// Stop a channel
+void disableUdmaChannel(uint8_t channel)
+{
+    UDMA_ENACLR_R = 1 << channel;
+}
+
+// Returns true while a channel has transfers outstanding (cleared by hardware on completion)
+bool isUdmaChannelEnabled(uint8_t channel)
+{
+    return (UDMA_ENASET_R & (1 << channel)) != 0;
+}
+
+// Returns true once a channel has completed, clearing its completion flag
+bool clearUdmaCompletion(uint8_t channel)
+{
+    uint32_t mask = 1 << channel;
+    if (!(UDMA_CHIS_R & mask))
+        return false;
+    UDMA_CHIS_R = mask;                              // write 1 to clear
+    return true;
+}
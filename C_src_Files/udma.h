@@ -0,0 +1,40 @@
+// uDMA Library
+// Mourya
+
+//-----------------------------------------------------------------------------
+// Hardware Target
+//-----------------------------------------------------------------------------
+
+// Target Platform: EK-TM4C123GXL
+// Target uC:       TM4C123GH6PM
+// System Clock:    -
+
+// Hardware configuration:
+// uDMA controller with a single 1024-byte aligned control table
+
+//-----------------------------------------------------------------------------
+// Device includes, defines, and assembler directives
+//-----------------------------------------------------------------------------
+
+#ifndef UDMA_H_
+#define UDMA_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Channel assignments (Refer Table 9-1 in data sheet, encoding 0)
+#define UDMA_CH_UART0_TX    9
+#define UDMA_CH_TIMER0A     18
+
+//-----------------------------------------------------------------------------
+// Subroutines
+//-----------------------------------------------------------------------------
+
+void initUdma()                                                                                             ;
+void setUdmaTransfer(uint8_t channel, bool alternate, const volatile void *srcEnd, volatile void *dstEnd, uint32_t control)   ;
+void enableUdmaChannel(uint8_t channel)                                                                     ;
+void disableUdmaChannel(uint8_t channel)                                                                    ;
+bool isUdmaChannelEnabled(uint8_t channel)                                                                  ;
+bool clearUdmaCompletion(uint8_t channel)                                                                   ;
+
+#endif
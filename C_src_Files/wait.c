@@ -6,22 +6,109 @@
 //-----------------------------------------------------------------------------
 
 // Target uC:       TM4C123GH6PM
-// System Clock:    40 MHz
+// System Clock:    -
+
+// Hardware configuration:
+// Timer 1A one-shot, used by waitMicrosecond() and sleepMicrosecond() once initWait() has run
 
 //-----------------------------------------------------------------------------
 // Device includes, defines, and assembler directives
 //-----------------------------------------------------------------------------
 
 #include <stdint.h>
+#include <stdbool.h>
 #include "tm4c123gh6pm.h"
+#include "clock.h"
+#include "nvic.h"
 #include "wait.h"
 
+#define WAIT_OVERHEAD_CYCLES 40                 // approximate cost of arming the timer and waking
+
+//-----------------------------------------------------------------------------
+// Global variables
+//-----------------------------------------------------------------------------
+
+uint32_t cyclesPerUs = 0;                       // 0 until initWait() has run
+volatile bool waitDone = false;
+
 //-----------------------------------------------------------------------------
 // Subroutines
 //-----------------------------------------------------------------------------
 
-// Approximate busy waiting (in units of microseconds), given a 40 MHz system clock
+// Initialize Timer 1A as a one-shot for waitMicrosecond(), call after the system clock is set
+void initWait(void)
+{
+    SYSCTL_RCGCTIMER_R |= SYSCTL_RCGCTIMER_R1;
+    _delay_cycles(3);
+
+    TIMER1_CTL_R &= ~TIMER_CTL_TAEN;            // turn-off timer before reconfiguring
+    TIMER1_CFG_R = TIMER_CFG_32_BIT_TIMER;      // configure as 32-bit timer (A+B)
+    TIMER1_TAMR_R = TIMER_TAMR_TAMR_1_SHOT;     // configure for one-shot mode (count down)
+    TIMER1_ICR_R = TIMER_ICR_TATOCINT;
+    TIMER1_IMR_R = TIMER_IMR_TATOIM;            // turn-on time-out interrupt
+    setNvicPriority(INT_TIMER1A, PRIORITY_WAIT);
+    NVIC_EN0_R = 1 << (INT_TIMER1A-16);         // turn-on interrupt 37 (TIMER1A)
+    cyclesPerUs = getSystemClockHz() / 1000000;
+}
+
+// Timer 1A interrupt, ends the present wait
+void timer1Isr(void)
+{
+    TIMER1_ICR_R = TIMER_ICR_TATOCINT;          // clear interrupt flag
+    waitDone = true;
+}
+
+// Waits on Timer 1A with the core asleep, other interrupts are serviced during the wait
+// Falls back to busy waiting before initWait(), must not be called from an interrupt
 void waitMicrosecond(uint32_t us)
+{
+    uint32_t cycles = us * cyclesPerUs;
+
+    if (cyclesPerUs == 0)
+    {
+        busyWaitMicrosecond(us);
+        return;
+    }
+    if (cycles <= WAIT_OVERHEAD_CYCLES)
+        return;
+
+    waitDone = false;
+    TIMER1_TAILR_R = cycles - WAIT_OVERHEAD_CYCLES;
+    TIMER1_CTL_R |= TIMER_CTL_TAEN;             // one-shot, disables itself at time-out
+
+    // masking interrupts around WFI closes the window between the test and the sleep
+    // a pending interrupt still wakes the core and is serviced once unmasked
+    __asm("    CPSID I");
+    while (!waitDone)
+    {
+        __asm("    WFI");
+        __asm("    CPSIE I");
+        __asm("    CPSID I");
+    }
+    __asm("    CPSIE I");
+}
+
+// Sleeps until any interrupt or for at most us (0 for no limit), for an idle loop that rechecks its work on waking
+// Call with interrupts masked, the interrupt that woke the core is serviced once the caller unmasks
+void sleepMicrosecond(uint32_t us)
+{
+    uint32_t cycles = us * cyclesPerUs;
+
+    if (us != 0)
+    {
+        if (cycles <= WAIT_OVERHEAD_CYCLES)
+            return;
+        TIMER1_TAILR_R = cycles - WAIT_OVERHEAD_CYCLES;
+        TIMER1_CTL_R |= TIMER_CTL_TAEN;
+    }
+    __asm("    WFI");
+
+    // another interrupt may end the sleep first, the next wait rearms the timer
+    TIMER1_CTL_R &= ~TIMER_CTL_TAEN;
+}
+
+// Approximate busy waiting (in units of microseconds), given a 40 MHz system clock
+void busyWaitMicrosecond(uint32_t us)
 {
 	__asm("WMS_LOOP0:   MOV  R1, #6");          // 1
     __asm("WMS_LOOP1:   SUB  R1, #1");          // 6
@@ -6,15 +6,23 @@
 //-----------------------------------------------------------------------------
 
 // Target uC:       TM4C123GH6PM
-// System Clock:    40 MHz
+// System Clock:    -
+
+// Hardware configuration:
+// Timer 1A one-shot, used by waitMicrosecond() once initWait() has run
 
 #ifndef WAIT_H_
 #define WAIT_H_
 
+#include <stdint.h>
+
 //-----------------------------------------------------------------------------
 // Subroutines
 //-----------------------------------------------------------------------------
 
+void initWait(void);
 void waitMicrosecond(uint32_t us);
+void sleepMicrosecond(uint32_t us);
+void busyWaitMicrosecond(uint32_t us);
 
 #endif